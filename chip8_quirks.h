@@ -0,0 +1,52 @@
+#ifndef C8_CHIP8_QUIRKS_H_
+#define C8_CHIP8_QUIRKS_H_
+
+#include "common.h"
+
+// Compile-time policies for the opcodes ROMs disagree on, used as the second
+// template argument of CpuChip8Impl. Each flag is checked with a constant
+// condition, so a quirk set costs nothing per instruction.
+//
+//   kShiftVy              8XY6/8XYE shift VY into VX rather than VX in place.
+//   kLoadStoreIncrementsI FX55/FX65 leave I pointing past the last register.
+//   kJumpVx               BNNN is BXNN: jump to XNN + VX rather than NNN + V0.
+//   kLogicResetsVf        8XY1/8XY2/8XY3 clear VF.
+//   kClipSprites          Sprites are clipped at the screen edges, not wrapped.
+
+// What this emulator has always done.
+struct LegacyQuirks {
+  static constexpr bool kShiftVy = false;
+  static constexpr bool kLoadStoreIncrementsI = false;
+  static constexpr bool kJumpVx = false;
+  static constexpr bool kLogicResetsVf = false;
+  static constexpr bool kClipSprites = false;
+};
+
+// The original COSMAC VIP interpreter.
+struct CosmacQuirks {
+  static constexpr bool kShiftVy = true;
+  static constexpr bool kLoadStoreIncrementsI = true;
+  static constexpr bool kJumpVx = false;
+  static constexpr bool kLogicResetsVf = true;
+  static constexpr bool kClipSprites = true;
+};
+
+// SUPER-CHIP 1.1 on the HP48.
+struct SuperChipQuirks {
+  static constexpr bool kShiftVy = false;
+  static constexpr bool kLoadStoreIncrementsI = false;
+  static constexpr bool kJumpVx = true;
+  static constexpr bool kLogicResetsVf = false;
+  static constexpr bool kClipSprites = true;
+};
+
+// Octo's XO-CHIP.
+struct XoChipQuirks {
+  static constexpr bool kShiftVy = true;
+  static constexpr bool kLoadStoreIncrementsI = true;
+  static constexpr bool kJumpVx = false;
+  static constexpr bool kLogicResetsVf = false;
+  static constexpr bool kClipSprites = false;
+};
+
+#endif
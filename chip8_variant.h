@@ -0,0 +1,40 @@
+#ifndef C8_CHIP8_VARIANT_H_
+#define C8_CHIP8_VARIANT_H_
+
+#include "common.h"
+
+// Compile-time descriptions of the CHIP-8 family machines, used as the
+// template argument of CpuChip8Impl. Every check against these folds away,
+// so the plain CHIP-8 machine never pays for the extensions.
+
+struct Chip8Variant {
+  static constexpr int kDisplayCols = 64;
+  static constexpr int kDisplayRows = 32;
+  static constexpr int kMemorySize = 0x1000;
+  static constexpr int kNumPlanes = 1;
+  // 00CN 00FB-00FF DXY0 FX30 FX75 FX85
+  static constexpr bool kSuperChip = false;
+  // 00DN 5XY2 5XY3 F000 NNNN FN01 F002 FX3A
+  static constexpr bool kXoChip = false;
+};
+
+// The display is always 128x64; lo-res mode draws 2x2 pixels.
+struct SuperChipVariant {
+  static constexpr int kDisplayCols = 128;
+  static constexpr int kDisplayRows = 64;
+  static constexpr int kMemorySize = 0x1000;
+  static constexpr int kNumPlanes = 1;
+  static constexpr bool kSuperChip = true;
+  static constexpr bool kXoChip = false;
+};
+
+struct XoChipVariant {
+  static constexpr int kDisplayCols = 128;
+  static constexpr int kDisplayRows = 64;
+  static constexpr int kMemorySize = 0x10000;
+  static constexpr int kNumPlanes = 2;
+  static constexpr bool kSuperChip = true;
+  static constexpr bool kXoChip = true;
+};
+
+#endif
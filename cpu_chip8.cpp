@@ -1,4 +1,5 @@
 #include "cpu_chip8.h"
+#include "cpu_chip8_impl.h"
 
 #include <thread>
 #include <atomic>
@@ -9,15 +10,23 @@
 #include <vector>
 #include <cmath>
 #include <string>
+#include <algorithm>
 
 #include "common.h"
+#include "chip8_quirks.h"
+#include "chip8_variant.h"
+#include "hash.h"
 #include "image.h"
+#include "rom_database.h"
+#include "shm_export.h"
 
-#define NEXT program_counter_ += 2
-#define SKIP program_counter_ += 4
+// For use in instructions, which run on cpu.
+#define NEXT cpu->program_counter_ += 2
+#define SKIP cpu->program_counter_ += cpu->SkipLength()
 
-constexpr int kMaxMemory = 0xFFF;
-constexpr int kMaxROMSize = kMaxMemory - 0x200;
+constexpr int kROMStart = 0x200;
+constexpr int kFontStart = 0x50;
+constexpr int kBigFontStart = 0xA0;
 
 using Clock = std::chrono::steady_clock;
 
@@ -30,21 +39,151 @@ void DBG(const char* str, ...) {
   va_end(arglist);
   #endif
 }
+
+// Picks the quirks instantiation for a variant. Options must be resolved.
+template <typename Variant>
+std::unique_ptr<CpuChip8> CreateWithQuirks(const CpuChip8::Options& options) {
+  switch (options.quirks) {
+    case CpuChip8::QuirkSet::kCosmac:
+      return std::unique_ptr<CpuChip8>(new CpuChip8Impl<Variant, CosmacQuirks>(options));
+    case CpuChip8::QuirkSet::kSuperChip:
+      return std::unique_ptr<CpuChip8>(new CpuChip8Impl<Variant, SuperChipQuirks>(options));
+    case CpuChip8::QuirkSet::kXoChip:
+      return std::unique_ptr<CpuChip8>(new CpuChip8Impl<Variant, XoChipQuirks>(options));
+    case CpuChip8::QuirkSet::kLegacy:
+    default:
+      return std::unique_ptr<CpuChip8>(new CpuChip8Impl<Variant, LegacyQuirks>(options));
+  }
+}
+}
+
+std::unique_ptr<CpuChip8> CpuChip8::Create(const Options& options) {
+  Options resolved = options;
+  ResolveOptions(&resolved);
+  switch (resolved.machine) {
+    case Machine::kSuperChip:
+      return CreateWithQuirks<SuperChipVariant>(resolved);
+    case Machine::kXoChip:
+      return CreateWithQuirks<XoChipVariant>(resolved);
+    case Machine::kChip8:
+    default:
+      return CreateWithQuirks<Chip8Variant>(resolved);
+  }
+}
+
+void CpuChip8::ResolveOptions(Options* options) {
+  if ((options->machine == Machine::kAuto || options->quirks == QuirkSet::kAuto) &&
+      !options->rom_database.empty()) {
+    Machine machine = Machine::kAuto;
+    QuirkSet quirks = QuirkSet::kAuto;
+    if (FindRom(options->rom_database, HashRomFile(options->rom_filename), &machine, &quirks)) {
+      if (options->machine == Machine::kAuto) options->machine = machine;
+      if (options->quirks == QuirkSet::kAuto) options->quirks = quirks;
+    }
+  }
+  if (options->machine == Machine::kAuto) options->machine = Machine::kChip8;
+  if (options->quirks == QuirkSet::kAuto) {
+    switch (options->machine) {
+      case Machine::kSuperChip:
+        options->quirks = QuirkSet::kSuperChip;
+        break;
+      case Machine::kXoChip:
+        options->quirks = QuirkSet::kXoChip;
+        break;
+      default:
+        // What this emulator always did, so existing golden hashes hold.
+        options->quirks = QuirkSet::kLegacy;
+        break;
+    }
+  }
+}
+
+void CpuChip8::DisplaySize(Machine machine, int* cols, int* rows) {
+  switch (machine) {
+    case Machine::kSuperChip:
+      *cols = SuperChipVariant::kDisplayCols;
+      *rows = SuperChipVariant::kDisplayRows;
+      break;
+    case Machine::kXoChip:
+      *cols = XoChipVariant::kDisplayCols;
+      *rows = XoChipVariant::kDisplayRows;
+      break;
+    case Machine::kChip8:
+    default:
+      *cols = Chip8Variant::kDisplayCols;
+      *rows = Chip8Variant::kDisplayRows;
+      break;
+  }
+}
+
+bool CpuChip8::ParseMachine(const std::string& name, Machine* machine) {
+  if (name == "auto") {
+    *machine = Machine::kAuto;
+  } else if (name == "chip8") {
+    *machine = Machine::kChip8;
+  } else if (name == "schip") {
+    *machine = Machine::kSuperChip;
+  } else if (name == "xochip") {
+    *machine = Machine::kXoChip;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool CpuChip8::ParseQuirkSet(const std::string& name, QuirkSet* quirks) {
+  if (name == "auto") {
+    *quirks = QuirkSet::kAuto;
+  } else if (name == "legacy") {
+    *quirks = QuirkSet::kLegacy;
+  } else if (name == "cosmac") {
+    *quirks = QuirkSet::kCosmac;
+  } else if (name == "schip") {
+    *quirks = QuirkSet::kSuperChip;
+  } else if (name == "xochip") {
+    *quirks = QuirkSet::kXoChip;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool CpuChip8::ParseEngine(const std::string& name, Engine* engine) {
+  if (name == "table") {
+    *engine = Engine::kTable;
+  } else if (name == "reference") {
+    *engine = Engine::kReference;
+  } else {
+    return false;
+  }
+  return true;
 }
 
-CpuChip8::CpuChip8(const Options& options) : options_(options), frame_(64, 32),
-    running_(false) { 
-  if (!options_.produce_frame_callback || !options_.set_keypad_state_callback) {
-    throw std::runtime_error("Invalid options -- callbacks not provided.");
+const char* CpuChip8::FaultName(Fault fault) {
+  switch (fault) {
+    case Fault::kNone: return "no fault";
+    case Fault::kUnknownOpcode: return "unknown opcode";
+    case Fault::kStackOverflow: return "stack overflow";
+    case Fault::kStackUnderflow: return "stack underflow";
   }
+  return "?";
 }
 
+std::string CpuChip8::DescribeFault(const FaultInfo& fault) {
+  if (fault.fault == Fault::kNone) return FaultName(fault.fault);
+  char text[96];
+  std::snprintf(text, sizeof(text), "%s %04X at %03X, cycle %llu", FaultName(fault.fault),
+    fault.opcode, fault.pc, static_cast<unsigned long long>(fault.cycle));
+  return text;
+}
+
+CpuChip8::CpuChip8(const Options& options) : options_(options), running_(false) {}
+
 void CpuChip8::Start() {
   if (running_.load()) throw std::runtime_error("Cannot call Start() twice.");
   running_ = true;
   cpu_thread_ = std::thread([this]() {
-    Initialize();
-    LoadROM(options_.rom_filename);
+    Boot();
     EmulationLoop();
   });
 }
@@ -56,74 +195,348 @@ void CpuChip8::Stop() {
   cpu_thread_.join();
 }
 
+void CpuChip8::Boot() {
+  std::ifstream input(options_.rom_filename, std::ios::in | std::ios::binary);
+  std::vector<uint8_t> bytes(
+         (std::istreambuf_iterator<char>(input)),
+         (std::istreambuf_iterator<char>()));
+  Boot(bytes.data(), bytes.size());
+  if (options_.verbose) {
+    std::cout << std::dec << "Loaded " << bytes.size() << " byte ROM " << options_.rom_filename
+      << " (hash " << std::hex << HashBytes(bytes.data(), bytes.size()) << std::dec << ")" << std::endl;
+  }
+}
+
+void CpuChip8::Boot(const uint8_t* rom, size_t size) {
+  SetROM(rom, size);
+  Initialize();
+}
+
+void CpuChip8::Reset() {
+  if (running_.load()) {
+    reset_pending_.store(true, std::memory_order_release);
+    return;
+  }
+  Initialize();
+}
+
+void CpuChip8::LoadROM(const uint8_t* rom, size_t size) {
+  if (!running_.load()) {
+    Boot(rom, size);
+    return;
+  }
+  // Checked here so the caller gets the error, not the worker.
+  if (size == 0 || size > static_cast<size_t>(MemorySize() - kROMStart)) {
+    throw std::runtime_error("ROM doesn't fit in memory.");
+  }
+  const std::lock_guard<std::mutex> lock(pending_mu_);
+  pending_rom_.assign(rom, rom + size);
+  reset_pending_.store(true, std::memory_order_release);
+}
+
+void CpuChip8::ApplyPendingReset() {
+  std::vector<uint8_t> rom;
+  {
+    const std::lock_guard<std::mutex> lock(pending_mu_);
+    rom.swap(pending_rom_);
+    reset_pending_ = false;
+  }
+  if (!rom.empty()) SetROM(rom.data(), rom.size());
+  Initialize();
+}
+
 void CpuChip8::EmulationLoop() {
+  Metrics* metrics = options_.metrics;
+  // Sleeps and records how far past the requested time we woke up.
+  auto sleep_for = [metrics](Clock::duration duration) {
+    auto wake_time = Clock::now() + duration;
+    std::this_thread::sleep_for(duration);
+    if (metrics) {
+      metrics->oversleep_us.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::max(Clock::now() - wake_time, Clock::duration::zero())).count());
+    }
+  };
+
   while (running_.load()) {
     auto start_time = Clock::now();
     // Execute kCycleSpeedHz instructions, emulating the refresh rate.
     for (int vsync = 0; vsync < kRefreshRateHz; vsync++) {
       auto frame_start = Clock::now();
-      options_.set_keypad_state_callback(keypad_state_);
-      for (int cycle = 0; cycle < kCyclesPerFrame; cycle++) {
-        RunCycle();
-
+      if (reset_pending_.load(std::memory_order_acquire)) ApplyPendingReset();
+      RunFrame();
+      auto frame_time = Clock::now() - frame_start;
+      if (metrics) {
+        metrics->frame_time_us.Record(
+          std::chrono::duration_cast<std::chrono::microseconds>(frame_time).count());
+        if (frame_time > std::chrono::microseconds(1'000'000 / kRefreshRateHz)) {
+          metrics->dropped_frames.Add();
+        }
       }
-      options_.produce_frame_callback(&frame_);
       // Run slightly faster than the emulated refresh rate, this is corrected in the per-second sleep.
-      std::chrono::duration<double> to_vsync = std::chrono::milliseconds(15) - (Clock::now() - frame_start);
+      auto to_vsync = std::chrono::milliseconds(15) - frame_time;
       if (to_vsync > Clock::duration::zero()) {
-        std::this_thread::sleep_for(to_vsync);
+        sleep_for(to_vsync);
       }
     }
 
     // Lock to kCycleSpeedHz every second.
-    std::chrono::duration<double> diff = Clock::now() - start_time;
-    std::cout << "\nCPU took " << std::chrono::duration_cast<std::chrono::milliseconds>(diff).count() << " ms";
-    std::chrono::duration<double> to_second = std::chrono::seconds(1) - diff;
+    auto to_second = std::chrono::seconds(1) - (Clock::now() - start_time);
     if (to_second > Clock::duration::zero()) {
-      std::cout << "\t CPU sleeping for " << std::chrono::duration_cast<std::chrono::milliseconds>(to_second).count() << " ms";
-      std::this_thread::sleep_for(to_second);
+      sleep_for(to_second);
     }
   }
 }
 
-void CpuChip8::RunCycle() {
+template <typename Variant, typename Quirks>
+CpuChip8Impl<Variant, Quirks>::CpuChip8Impl(const Options& options) : CpuChip8(options),
+    pristine_memory_(std::make_shared<Memory>()),
+    rng_(options.random_seed),
+    shm_(options.shm_name.empty() ? nullptr :
+      new ShmExport(options.shm_name, Variant::kDisplayCols, Variant::kDisplayRows)),
+    frame_(Variant::kDisplayCols, Variant::kDisplayRows),
+    engine_instructions_(options.engine == Engine::kReference ?
+      &ReferenceInstructionSet() : &InstructionSet()),
+    instructions_(engine_instructions_) {
+  // Registers are zeroed in their declarations, so a machine read before
+  // Boot() shows a blank screen rather than uninitialized memory.
+  frame_.SetAll(0);
+}
+
+namespace {
+// The options a fork keeps, see CpuChip8::Fork().
+CpuChip8::Options ForkOptions(const CpuChip8::Options& options) {
+  CpuChip8::Options fork_options;
+  fork_options.machine = options.machine;
+  fork_options.quirks = options.quirks;
+  fork_options.engine = options.engine;
+  fork_options.random_seed = options.random_seed;
+  fork_options.verbose = false;
+  return fork_options;
+}
+}
+
+template <typename Variant, typename Quirks>
+CpuChip8Impl<Variant, Quirks>::CpuChip8Impl(const CpuChip8Impl& other) :
+    CpuChip8(ForkOptions(other.options_)),
+    current_opcode_(other.current_opcode_),
+    memory_(other.memory_),
+    pristine_memory_(other.pristine_memory_),
+    index_register_(other.index_register_),
+    program_counter_(other.program_counter_),
+    delay_timer_(other.delay_timer_),
+    sound_timer_(other.sound_timer_),
+    sound_on_(other.sound_on_),
+    num_cycles_(other.num_cycles_),
+    stack_pointer_(other.stack_pointer_),
+    waitkey_key_(other.waitkey_key_),
+    fault_(other.fault_),
+    rng_(other.rng_),
+    hires_(other.hires_),
+    planes_(other.planes_),
+    pitch_(other.pitch_),
+    frame_(Variant::kDisplayCols, Variant::kDisplayRows),
+    engine_instructions_(other.engine_instructions_),
+    instructions_(engine_instructions_) {
+  std::memcpy(v_registers_, other.v_registers_, sizeof(v_registers_));
+  std::memcpy(stack_, other.stack_, sizeof(stack_));
+  std::memcpy(keypad_state_, other.keypad_state_, sizeof(keypad_state_));
+  std::memcpy(rpl_flags_, other.rpl_flags_, sizeof(rpl_flags_));
+  std::memcpy(audio_pattern_, other.audio_pattern_, sizeof(audio_pattern_));
+  std::memcpy(frame_.Row(0), other.frame_.Row(0),
+    Variant::kDisplayCols * Variant::kDisplayRows);
+}
+
+template <typename Variant, typename Quirks>
+std::unique_ptr<CpuChip8> CpuChip8Impl<Variant, Quirks>::Fork() const {
+  return std::unique_ptr<CpuChip8>(new CpuChip8Impl(*this));
+}
+
+template <typename Variant, typename Quirks>
+uint64_t CpuChip8Impl<Variant, Quirks>::StateHash() const {
+  Registers regs = GetRegisters();
+  uint64_t hash = HashBytes(&regs, sizeof(regs));
+  // The fault register's cycle doesn't change what happens next.
+  hash = HashBytes(&fault_.fault, sizeof(fault_.fault), hash);
+  hash = HashBytes(&waitkey_key_, sizeof(waitkey_key_), hash);
+  hash = HashBytes(&hires_, sizeof(hires_), hash);
+  hash = HashBytes(&planes_, sizeof(planes_), hash);
+  hash = HashBytes(rpl_flags_, sizeof(rpl_flags_), hash);
+  hash = HashBytes(audio_pattern_, sizeof(audio_pattern_), hash);
+  hash = HashBytes(&pitch_, sizeof(pitch_), hash);
+  // minstd_rand's whole state is its last output.
+  std::minstd_rand rng = rng_;
+  uint32_t next_random = rng();
+  hash = HashBytes(&next_random, sizeof(next_random), hash);
+  uint64_t memory_hash = memory_.Hash();
+  hash = HashBytes(&memory_hash, sizeof(memory_hash), hash);
+  return HashWords(frame_.Row(0), Variant::kDisplayCols * Variant::kDisplayRows, hash);
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::RunFrame() {
+  if (options_.set_keypad_state_callback) {
+    options_.set_keypad_state_callback(keypad_state_);
+    if (options_.latency) options_.latency->KeypadApplied();
+  }
+  if (shm_) shm_->ReadKeypad(keypad_state_);
+  RunCycles(kCyclesPerFrame);
+  if (shm_) shm_->Publish(frame_, GetRegisters(), num_cycles_);
+  if (options_.produce_frame_callback) options_.produce_frame_callback(&frame_);
+  if (options_.latency) options_.latency->FrameProduced(&frame_);
+  if (options_.metrics) {
+    options_.metrics->cycles_executed.Add(kCyclesPerFrame);
+    options_.metrics->frames_produced.Add();
+  }
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::RunCycles(int n) {
+  for (int cycle = 0; cycle < n; cycle++) {
+    RunCycle();
+  }
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::SetKeypad(uint16_t keys) {
+  for (int key = 0; key < 16; key++) {
+    keypad_state_[key] = (keys >> key) & 1;
+  }
+}
+
+template <typename Variant, typename Quirks>
+CpuChip8::Registers CpuChip8Impl<Variant, Quirks>::GetRegisters() const {
+  Registers regs;
+  // Zero the padding too so snapshots can be hashed bytewise.
+  std::memset(&regs, 0, sizeof(regs));
+  std::memcpy(regs.v, v_registers_, sizeof(regs.v));
+  regs.index = index_register_;
+  regs.pc = program_counter_;
+  std::memcpy(regs.stack, stack_, sizeof(regs.stack));
+  regs.sp = stack_pointer_;
+  regs.delay_timer = delay_timer_;
+  regs.sound_timer = sound_timer_;
+  return regs;
+}
+
+template <typename Variant, typename Quirks>
+int CpuChip8Impl<Variant, Quirks>::SkipLength() const {
+  if (Variant::kXoChip && Mem(program_counter_ + 2) == 0xF0 &&
+      Mem(program_counter_ + 3) == 0x00) {
+    return 6;
+  }
+  return 4;
+}
+
+template <typename Variant, typename Quirks>
+uint8_t CpuChip8Impl<Variant, Quirks>::PlaneMask() const {
+  return planes_ == (1 << Variant::kNumPlanes) - 1 ? Image::kAllPlanes : planes_;
+}
+
+template <typename Variant, typename Quirks>
+int CpuChip8Impl<Variant, Quirks>::Scale() const {
+  return Variant::kSuperChip && !hires_ ? 2 : 1;
+}
+
+template <typename Variant, typename Quirks>
+bool CpuChip8Impl<Variant, Quirks>::DrawSprite(uint8_t x, uint8_t y, int rows, int bytes_per_row) {
+  int scale = Scale();
+  int index = index_register_ & kAddressMask;
+  const uint8_t* sprite = memory_.Span(index);
+  // A sprite running into the next page, or off the end of memory and
+  // wrapping, is read through a copy.
+  int size = rows * bytes_per_row * Variant::kNumPlanes;
+  uint8_t copy[kMaxSpriteBytes];
+  if (size > Memory::SpanLength(index)) {
+    memory_.CopyOut(index, size, copy);
+    sprite = copy;
+  }
+  if (Variant::kNumPlanes == 1) {
+    return frame_.XORSprite<Quirks::kClipSprites>(x * scale, y * scale, rows, sprite,
+      bytes_per_row, 1, scale);
+  }
+  // Each selected plane reads its own copy of the sprite, in plane order.
+  bool pixels_unset = false;
+  for (int plane = 0; plane < Variant::kNumPlanes; plane++) {
+    uint8_t bit = 1 << plane;
+    if (!(planes_ & bit)) continue;
+    pixels_unset |= frame_.XORSprite<Quirks::kClipSprites>(x * scale, y * scale, rows, sprite,
+      bytes_per_row, bit, scale);
+    sprite += rows * bytes_per_row;
+  }
+  return pixels_unset;
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::RunCycle() {
   // Read in the big-endian opcode word.
-  current_opcode_ = memory_[program_counter_] << 8 |
-    memory_[program_counter_ + 1];
+  current_opcode_ = memory_.Fetch(program_counter_ & kAddressMask);
   DBG("\n0x%X - 0x%X\t", program_counter_, current_opcode_);
 
-  auto instr = instructions_.find(current_opcode_);
-  if (instr != instructions_.end()) {
-    instr->second();
-  } else {
-    throw std::runtime_error("Couldn't find instruction for opcode " +
-      std::to_string(current_opcode_));
-  }
+  (*instructions_.load(std::memory_order_acquire))[current_opcode_](this);
 
   // Update timers
   num_cycles_++;
   if (num_cycles_ % kCyclesPerFrame == 0) {
     if (delay_timer_ > 0) delay_timer_--;
     if (sound_timer_ > 0) {
-      std::cout << "BEEPING" << std::endl;
       sound_timer_--;
+      UpdateSound();
     }
   }
   DbgReg();
 }
 
-void CpuChip8::Initialize() {
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::RaiseFault(Fault fault) {
+  if (fault_.fault != Fault::kNone) return;
+  fault_ = FaultInfo{fault, program_counter_, current_opcode_, num_cycles_};
+  DBG("FAULT %s", FaultName(fault));
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::UpdateSound() {
+  bool on = sound_timer_ > 0;
+  if (on != sound_on_ && options_.sound_edges) {
+    options_.sound_edges->Push(SoundEdge{num_cycles_, on});
+  }
+  sound_on_ = on;
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::Initialize() {
   current_opcode_ = 0;
-  std::memset(memory_, 0, 4096);
+  memory_ = *pristine_memory_;
   std::memset(v_registers_, 0, 16);
   index_register_ = 0;
-  program_counter_ = 0x200; 
+  program_counter_ = kROMStart;
   delay_timer_ = 0;
   sound_timer_ = 0;
-  std::memset(stack_, 0, 16);
+  // Publishes the off edge if a tone was playing, or it would keep playing
+  // into the next ROM.
+  UpdateSound();
+  std::memset(stack_, 0, sizeof(stack_));
   stack_pointer_ = 0;
   std::memset(keypad_state_, 0, 16);
-  
+  rng_.seed(options_.random_seed);
+  hires_ = false;
+  planes_ = 1;
+  std::memset(audio_pattern_, 0, sizeof(audio_pattern_));
+  pitch_ = 64;
+  waitkey_key_ = -1;
+  fault_ = FaultInfo{Fault::kNone, 0, 0, 0};
+  frame_.SetAll(0);
+
+  if (options_.verbose) std::cout << "Initialization complete." << std::endl;
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::SetROM(const uint8_t* rom, size_t size) {
+  if (size > Variant::kMemorySize - kROMStart) {
+    throw std::runtime_error("File size is bigger than max rom size.");
+  } else if (size <= 0) {
+    throw std::runtime_error("No file or empty file.");
+  }
+  std::shared_ptr<Memory> pristine = std::make_shared<Memory>();
   uint8_t chip8_fontset[80] =
   { 
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
@@ -144,339 +557,654 @@ void CpuChip8::Initialize() {
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
   };
   // Load the built-in fontset into 0x050-0x0A0
-  std::memcpy(memory_ + 0x50, chip8_fontset, 80);
-  frame_.SetAll(0);
+  for (int i = 0; i < 80; i++) pristine->Write(kFontStart + i, chip8_fontset[i]);
+  if (Variant::kSuperChip) {
+    uint8_t big_fontset[160] =
+    {
+      0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+      0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+      0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+      0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+      0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+      0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+      0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+      0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+      0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+      0x3C, 0x7E, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, // A
+      0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+      0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C, // C
+      0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF, // E
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    };
+    // Load the big fontset into 0x0A0-0x140
+    for (int i = 0; i < 160; i++) pristine->Write(kBigFontStart + i, big_fontset[i]);
+  }
+  for (size_t i = 0; i < size; i++) pristine->Write(kROMStart + i, rom[i]);
+  pristine_memory_ = pristine;
+  DbgMem();
+}
 
-  BuildInstructionSet();
-  std::cout << "Initialization complete." << std::endl;
+template <typename Variant, typename Quirks>
+const std::vector<typename CpuChip8Impl<Variant, Quirks>::Instruction>&
+CpuChip8Impl<Variant, Quirks>::InstructionSet() {
+  // Built on first use, thread-safe.
+  static const std::vector<Instruction> instructions = BuildInstructionSet();
+  return instructions;
 }
 
-void CpuChip8::LoadROM(const std::string& filename) {
-  std::ifstream input(filename, std::ios::in | std::ios::binary);
-  std::vector<uint8_t> bytes(
-         (std::istreambuf_iterator<char>(input)),
-         (std::istreambuf_iterator<char>()));
-  if (bytes.size() > kMaxROMSize) {
-    throw std::runtime_error("File size is bigger than max rom size.");
-  } else if (bytes.size() <= 0) {
-    throw std::runtime_error("No file or empty file.");
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::Trap(CpuChip8Impl* cpu) {
+  cpu->debug_hook_();
+  (*cpu->engine_instructions_)[cpu->current_opcode_](cpu);
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::SetDebugHook(std::function<void()> hook) {
+  if (!hook) {
+    // The old hook stays in place for a CPU still returning from it.
+    instructions_.store(engine_instructions_, std::memory_order_release);
+    return;
   }
-  std::memcpy(memory_ + 0x200, bytes.data(), bytes.size());
-  std::cout << std::endl << std::dec << "Loaded " << bytes.size() << " byte ROM " << filename << std::endl;
-  DbgMem();
+  debug_hook_ = hook;
+  if (!trap_table_) {
+    trap_table_.reset(new std::vector<Instruction>(*engine_instructions_));
+    trap_all_table_.reset(new std::vector<Instruction>(0x10000, &Trap));
+    trapped_.assign(0x10000, false);
+  }
+  instructions_.store(trap_table_.get(), std::memory_order_release);
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::TrapAll(bool trap_all) {
+  if (!trap_table_) return;
+  instructions_.store(trap_all ? trap_all_table_.get() : trap_table_.get(),
+    std::memory_order_release);
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::SetTrappedOpcodes(const std::vector<uint16_t>& opcodes) {
+  if (!trap_table_) return;
+  std::vector<bool> trapped(0x10000, false);
+  for (uint16_t opcode : opcodes) trapped[opcode] = true;
+  const std::vector<Instruction>& shared = *engine_instructions_;
+  // Only touch entries that change, the paused CPU may be inside one.
+  for (int opcode = 0; opcode <= 0xFFFF; opcode++) {
+    if (trapped[opcode] != trapped_[opcode]) {
+      (*trap_table_)[opcode] = trapped[opcode] ? Instruction(&Trap) : shared[opcode];
+    }
+  }
+  trapped_.swap(trapped);
+}
+
+template <typename Variant, typename Quirks>
+std::vector<typename CpuChip8Impl<Variant, Quirks>::Instruction>
+CpuChip8Impl<Variant, Quirks>::BuildInstructionSet() {
+  std::vector<Instruction> instructions_(0x10000);
+  for (int opcode = 0; opcode <= 0xFFFF; opcode++) {
+    instructions_[opcode] = Decode(opcode);
+  }
+  return instructions_;
+}
+
+template <typename Variant, typename Quirks>
+const std::vector<typename CpuChip8Impl<Variant, Quirks>::Instruction>&
+CpuChip8Impl<Variant, Quirks>::ReferenceInstructionSet() {
+  static const std::vector<Instruction> instructions(0x10000, &DecodeAndRun);
+  return instructions;
+}
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::DecodeAndRun(CpuChip8Impl* cpu) {
+  Decode(cpu->current_opcode_)(cpu);
 }
 
-void CpuChip8::BuildInstructionSet() {
-  instructions_.clear();
-  instructions_.reserve(0xFFFF);
-
-  instructions_[0x00E0] = [this]() { frame_.SetAll(0); DBG("CLS"); NEXT; };
-  instructions_[0x00EE] = [this]() {
-    program_counter_ = stack_[--stack_pointer_] + 2;  // RET
-    DBG("RET -- POPPED pc=0x%X off the stack.", program_counter_);
-  };
-
-  for (int opcode = 0x1000; opcode < 0xFFFF; opcode++) {
-    uint16_t nnn =  opcode & 0x0FFF;
-    uint8_t kk =    opcode & 0x00FF;
-    uint8_t x =     (opcode & 0x0F00) >> 8;
-    uint8_t y =     (opcode & 0x00F0) >> 4;
-    uint8_t n =     opcode & 0x000F;
-    if ((opcode & 0xF000) == 0x1000) {
-      instructions_[opcode] = GenJP(nnn);
-    } else if ((opcode & 0xF000) == 0x2000) {
-      instructions_[opcode] = GenCALL(nnn);
-    } else if ((opcode & 0xF000) == 0x3000) {
-      instructions_[opcode] = GenSE(x, kk);
-    } else if ((opcode & 0xF000) == 0x4000) {
-      instructions_[opcode] = GenSNE(x, kk);
-    } else if ((opcode & 0xF00F) == 0x5000) {
-      instructions_[opcode] = GenSEREG(x, y);
-    } else if ((opcode & 0xF000) == 0x6000) {
-      instructions_[opcode] = GenLDIMM(x, kk);
-    } else if ((opcode & 0xF000) == 0x7000) {
-      instructions_[opcode] = GenADDIMM(x, kk);
-    } else if ((opcode & 0xF00F) == 0x8000) {
-      instructions_[opcode] = GenLDV(x, y);
-    } else if ((opcode & 0xF00F) == 0x8001) {
-      instructions_[opcode] = GenOR(x, y);
-    } else if ((opcode & 0xF00F) == 0x8002) {
-      instructions_[opcode] = GenAND(x, y);
-    } else if ((opcode & 0xF00F) == 0x8003) {
-      instructions_[opcode] = GenXOR(x, y);
-    } else if ((opcode & 0xF00F) == 0x8004) {
-      instructions_[opcode] = GenADD(x, y);
-    } else if ((opcode & 0xF00F) == 0x8005) {
-      instructions_[opcode] = GenSUB(x, y);
-    } else if ((opcode & 0xF00F) == 0x8006) {
-      instructions_[opcode] = GenSHR(x);
-    } else if ((opcode & 0xF00F) == 0x8007) {
-      instructions_[opcode] = GenSUBN(x, y);
-    } else if ((opcode & 0xF00F) == 0x800E) {
-      instructions_[opcode] = GenSHL(x);
-    } else if ((opcode & 0xF00F) == 0x9000) {
-      instructions_[opcode] = GenSNEREG(x, y);
-    } else if ((opcode & 0xF000) == 0xA000) {
-      instructions_[opcode] = GenLDI(nnn);
-    } else if ((opcode & 0xF000) == 0xB000) {
-      instructions_[opcode] = GenJPREG(nnn);
-    } else if ((opcode & 0xF000) == 0xC000) {
-      instructions_[opcode] = GenRND(x, kk);
-    } else if ((opcode & 0xF000) == 0xD000) {
-      instructions_[opcode] = GenDRAW(x, y, n);
-    } else if ((opcode & 0xF0FF) == 0xE09E) {
-      instructions_[opcode] = GenSKEY(x);
-    } else if ((opcode & 0xF0FF) == 0xE0A1) {
-      instructions_[opcode] = GenSNKEY(x);
-    } else if ((opcode & 0xF0FF) == 0xF007) {
-      instructions_[opcode] = GenRDELAY(x);
-    } else if ((opcode & 0xF0FF) == 0xF00A) {
-      instructions_[opcode] = GenWAITKEY(x);
-    } else if ((opcode & 0xF0FF) == 0xF015) {
-      instructions_[opcode] = GenWDELAY(x);
-    } else if ((opcode & 0xF0FF) == 0xF018) {
-      instructions_[opcode] = GenWSOUND(x);
-    } else if ((opcode & 0xF0FF) == 0xF01E) {
-      instructions_[opcode] = GenADDI(x);
-    } else if ((opcode & 0xF0FF) == 0xF029) {
-      instructions_[opcode] = GenLDSPRITE(x);
-    } else if ((opcode & 0xF0FF) == 0xF033) {
-      instructions_[opcode] = GenSTBCD(x);
-    } else if ((opcode & 0xF0FF) == 0xF055) {
-      instructions_[opcode] = GenSTREG(x);
-    } else if ((opcode & 0xF0FF) == 0xF065) {
-      instructions_[opcode] = GenLDREG(x);
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::Decode(uint16_t opcode) {
+  if (opcode == 0x00E0) {
+    return [](CpuChip8Impl* cpu) {
+      cpu->frame_.Clear(cpu->PlaneMask());
+      DBG("CLS");
+      NEXT;
+    };
+  } else if (opcode == 0x00EE) {
+    return [](CpuChip8Impl* cpu) {
+      if (cpu->stack_pointer_ == 0) return cpu->RaiseFault(Fault::kStackUnderflow);
+      cpu->program_counter_ = cpu->stack_[--cpu->stack_pointer_] + 2;  // RET
+      DBG("RET -- POPPED pc=0x%X off the stack.", cpu->program_counter_);
+    };
+  }
+  if (Variant::kSuperChip) {
+    if ((opcode & 0xFFF0) == 0x00C0) return GenSCROLLDOWN(opcode & 0xF);
+    if (opcode == 0x00FB) return GenSCROLLRIGHT();
+    if (opcode == 0x00FC) return GenSCROLLLEFT();
+    if (opcode == 0x00FD) return GenEXIT();
+    if (opcode == 0x00FE) return GenLORES();
+    if (opcode == 0x00FF) return GenHIRES();
+  }
+  if (Variant::kXoChip && (opcode & 0xFFF0) == 0x00D0) return GenSCROLLUP(opcode & 0xF);
+
+  uint16_t nnn =  opcode & 0x0FFF;
+  uint8_t kk =    opcode & 0x00FF;
+  uint8_t x =     (opcode & 0x0F00) >> 8;
+  uint8_t y =     (opcode & 0x00F0) >> 4;
+  uint8_t n =     opcode & 0x000F;
+  if ((opcode & 0xF000) == 0x1000) {
+    return GenJP(nnn);
+  } else if ((opcode & 0xF000) == 0x2000) {
+    return GenCALL(nnn);
+  } else if ((opcode & 0xF000) == 0x3000) {
+    return GenSE(x, kk);
+  } else if ((opcode & 0xF000) == 0x4000) {
+    return GenSNE(x, kk);
+  } else if ((opcode & 0xF00F) == 0x5000) {
+    return GenSEREG(x, y);
+  } else if (Variant::kXoChip && (opcode & 0xF00F) == 0x5002) {
+    return GenSTRANGE(x, y);
+  } else if (Variant::kXoChip && (opcode & 0xF00F) == 0x5003) {
+    return GenLDRANGE(x, y);
+  } else if ((opcode & 0xF000) == 0x6000) {
+    return GenLDIMM(x, kk);
+  } else if ((opcode & 0xF000) == 0x7000) {
+    return GenADDIMM(x, kk);
+  } else if ((opcode & 0xF00F) == 0x8000) {
+    return GenLDV(x, y);
+  } else if ((opcode & 0xF00F) == 0x8001) {
+    return GenOR(x, y);
+  } else if ((opcode & 0xF00F) == 0x8002) {
+    return GenAND(x, y);
+  } else if ((opcode & 0xF00F) == 0x8003) {
+    return GenXOR(x, y);
+  } else if ((opcode & 0xF00F) == 0x8004) {
+    return GenADD(x, y);
+  } else if ((opcode & 0xF00F) == 0x8005) {
+    return GenSUB(x, y);
+  } else if ((opcode & 0xF00F) == 0x8006) {
+    return GenSHR(x, y);
+  } else if ((opcode & 0xF00F) == 0x8007) {
+    return GenSUBN(x, y);
+  } else if ((opcode & 0xF00F) == 0x800E) {
+    return GenSHL(x, y);
+  } else if ((opcode & 0xF00F) == 0x9000) {
+    return GenSNEREG(x, y);
+  } else if ((opcode & 0xF000) == 0xA000) {
+    return GenLDI(nnn);
+  } else if ((opcode & 0xF000) == 0xB000) {
+    return GenJPREG(nnn, x);
+  } else if ((opcode & 0xF000) == 0xC000) {
+    return GenRND(x, kk);
+  } else if ((opcode & 0xF000) == 0xD000) {
+    if (Variant::kSuperChip && n == 0) {
+      return GenDRAW16(x, y);
+    } else {
+      return GenDRAW(x, y, n);
     }
+  } else if ((opcode & 0xF0FF) == 0xE09E) {
+    return GenSKEY(x);
+  } else if ((opcode & 0xF0FF) == 0xE0A1) {
+    return GenSNKEY(x);
+  } else if ((opcode & 0xF0FF) == 0xF007) {
+    return GenRDELAY(x);
+  } else if ((opcode & 0xF0FF) == 0xF00A) {
+    return GenWAITKEY(x);
+  } else if ((opcode & 0xF0FF) == 0xF015) {
+    return GenWDELAY(x);
+  } else if ((opcode & 0xF0FF) == 0xF018) {
+    return GenWSOUND(x);
+  } else if ((opcode & 0xF0FF) == 0xF01E) {
+    return GenADDI(x);
+  } else if ((opcode & 0xF0FF) == 0xF029) {
+    return GenLDSPRITE(x);
+  } else if ((opcode & 0xF0FF) == 0xF033) {
+    return GenSTBCD(x);
+  } else if ((opcode & 0xF0FF) == 0xF055) {
+    return GenSTREG(x);
+  } else if ((opcode & 0xF0FF) == 0xF065) {
+    return GenLDREG(x);
+  } else if (Variant::kSuperChip && (opcode & 0xF0FF) == 0xF030) {
+    return GenLDBIGSPRITE(x);
+  } else if (Variant::kSuperChip && (opcode & 0xF0FF) == 0xF075) {
+    return GenSTRPL(x);
+  } else if (Variant::kSuperChip && (opcode & 0xF0FF) == 0xF085) {
+    return GenLDRPL(x);
+  } else if (Variant::kXoChip && opcode == 0xF000) {
+    return GenLDILONG();
+  } else if (Variant::kXoChip && opcode == 0xF002) {
+    return GenAUDIO();
+  } else if (Variant::kXoChip && (opcode & 0xF0FF) == 0xF001) {
+    return GenPLANE(x);
+  } else if (Variant::kXoChip && (opcode & 0xF0FF) == 0xF03A) {
+    return GenPITCH(x);
   }
+  return [](CpuChip8Impl* cpu) {
+    cpu->RaiseFault(Fault::kUnknownOpcode);
+  };
 }
 
-CpuChip8::Instruction CpuChip8::GenJP(uint16_t addr) {
-  return [this, addr]() {  program_counter_ = addr; DBG("JP %d", addr); };
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenJP(uint16_t addr) {
+  return [addr](CpuChip8Impl* cpu) {  cpu->program_counter_ = addr; DBG("JP %d", addr); };
 }
-CpuChip8::Instruction CpuChip8::GenCALL(uint16_t addr) {
-  return [this, addr]() {
-    stack_[stack_pointer_++] = program_counter_;
-    DBG("CALL 0x%X - PUSH 0x%X onto stack", addr, stack_[stack_pointer_ - 1]);
-    program_counter_ = addr;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenCALL(uint16_t addr) {
+  return [addr](CpuChip8Impl* cpu) {
+    if (cpu->stack_pointer_ == kStackDepth) return cpu->RaiseFault(Fault::kStackOverflow);
+    cpu->stack_[cpu->stack_pointer_++] = cpu->program_counter_;
+    DBG("CALL 0x%X - PUSH 0x%X onto stack", addr, cpu->stack_[cpu->stack_pointer_ - 1]);
+    cpu->program_counter_ = addr;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSE(uint8_t reg, uint8_t val) {
-  return [this, reg, val]() {
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSE(uint8_t reg, uint8_t val) {
+  return [reg, val](CpuChip8Impl* cpu) {
     DBG("SE V%d, imm:%d", reg, val);
-    v_registers_[reg] == val ? SKIP : NEXT;
+    cpu->v_registers_[reg] == val ? SKIP : NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSNE(uint8_t reg, uint8_t val) {
-  return [this, reg, val]() {
-    v_registers_[reg] != val ? SKIP : NEXT;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSNE(uint8_t reg, uint8_t val) {
+  return [reg, val](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg] != val ? SKIP : NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSEREG(uint8_t reg_x, uint8_t reg_y) {
-  return [this, reg_x, reg_y]() {
-    v_registers_[reg_x] == v_registers_[reg_y] ? SKIP : NEXT;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSEREG(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg_x] == cpu->v_registers_[reg_y] ? SKIP : NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenLDIMM(uint8_t reg, uint8_t val) {
-  return [this, reg, val]() {
-    v_registers_[reg] = val;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLDIMM(uint8_t reg, uint8_t val) {
+  return [reg, val](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg] = val;
     DBG("V%d <== %X", reg, val);
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenADDIMM(uint8_t reg, uint8_t val) {
-  return [this, reg, val]() {
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenADDIMM(uint8_t reg, uint8_t val) {
+  return [reg, val](CpuChip8Impl* cpu) {
     DBG("V%d <== V%d + 0x%X", reg, reg, val);
-    v_registers_[reg] += val; // Note: Carry flag doesn't change here.
+    cpu->v_registers_[reg] += val; // Note: Carry flag doesn't change here.
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenLDV(uint8_t reg_x, uint8_t reg_y) {
-  return [this, reg_x, reg_y]() {
-    v_registers_[reg_x] = v_registers_[reg_y];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLDV(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg_x] = cpu->v_registers_[reg_y];
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenOR(uint8_t reg_x, uint8_t reg_y) {
-  return [this, reg_x, reg_y]() {
-    v_registers_[reg_x] |= v_registers_[reg_y];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenOR(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg_x] |= cpu->v_registers_[reg_y];
+    if (Quirks::kLogicResetsVf) cpu->v_registers_[0xF] = 0;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenAND(uint8_t reg_x, uint8_t reg_y) {
-  return [this, reg_x, reg_y]() {
-    v_registers_[reg_x] &= v_registers_[reg_y];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenAND(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg_x] &= cpu->v_registers_[reg_y];
+    if (Quirks::kLogicResetsVf) cpu->v_registers_[0xF] = 0;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenXOR(uint8_t reg_x, uint8_t reg_y) {
-  return [this, reg_x, reg_y]() {
-    v_registers_[reg_x] ^= v_registers_[reg_y];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenXOR(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg_x] ^= cpu->v_registers_[reg_y];
+    if (Quirks::kLogicResetsVf) cpu->v_registers_[0xF] = 0;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenADD(uint8_t reg_x, uint8_t reg_y) {
-  return [this, reg_x, reg_y]() {
-    uint16_t res = v_registers_[reg_x] += v_registers_[reg_y];
-    v_registers_[0xF] = res > 0xFF; // set carry
-    v_registers_[reg_x] = res;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenADD(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    uint16_t res = cpu->v_registers_[reg_x] += cpu->v_registers_[reg_y];
+    cpu->v_registers_[0xF] = res > 0xFF; // set carry
+    cpu->v_registers_[reg_x] = res;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSUB(uint8_t reg_x, uint8_t reg_y) {
-  return [this, reg_x, reg_y]() {
-    v_registers_[0xF] = v_registers_[reg_x] > v_registers_[reg_y]; // set not borrow
-    v_registers_[reg_x] -= v_registers_[reg_y];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSUB(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    cpu->v_registers_[0xF] = cpu->v_registers_[reg_x] > cpu->v_registers_[reg_y]; // set not borrow
+    cpu->v_registers_[reg_x] -= cpu->v_registers_[reg_y];
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSHR(uint8_t reg_x) {
-  return [this, reg_x]() {
-    v_registers_[0xF] = v_registers_[reg_x] & 1;
-    v_registers_[reg_x] >>= 1;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSHR(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    uint8_t src = cpu->v_registers_[Quirks::kShiftVy ? reg_y : reg_x];
+    // VF last, it wins when it is also reg_x.
+    cpu->v_registers_[reg_x] = src >> 1;
+    cpu->v_registers_[0xF] = src & 1;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSUBN(uint8_t reg_x, uint8_t reg_y) {
-  return [this, reg_x, reg_y]() {
-    v_registers_[0xF] = v_registers_[reg_y] > v_registers_[reg_x]; // set not borrow
-    v_registers_[reg_x] = v_registers_[reg_y] - v_registers_[reg_x];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSUBN(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    cpu->v_registers_[0xF] = cpu->v_registers_[reg_y] > cpu->v_registers_[reg_x]; // set not borrow
+    cpu->v_registers_[reg_x] = cpu->v_registers_[reg_y] - cpu->v_registers_[reg_x];
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSHL(uint8_t reg_x) {
-  return [this, reg_x]() {
-    v_registers_[0xF] = v_registers_[reg_x] > 0x80;
-    v_registers_[reg_x] <<= 1;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSHL(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    uint8_t src = cpu->v_registers_[Quirks::kShiftVy ? reg_y : reg_x];
+    cpu->v_registers_[reg_x] = src << 1;
+    cpu->v_registers_[0xF] = src >> 7;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSNEREG(uint8_t reg_x, uint8_t reg_y) {
-  return [this, reg_x, reg_y]() {
-    v_registers_[reg_x] != v_registers_[reg_y] ? SKIP : NEXT;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSNEREG(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg_x] != cpu->v_registers_[reg_y] ? SKIP : NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenLDI(uint16_t addr) {
-  return [this, addr]() {
-    index_register_ = addr;
-    DBG("I <== 0x%X", index_register_, addr);
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLDI(uint16_t addr) {
+  return [addr](CpuChip8Impl* cpu) {
+    cpu->index_register_ = addr;
+    DBG("I <== 0x%X", cpu->index_register_, addr);
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenJPREG(uint16_t addr) {
-  return [this, addr]() {  program_counter_ = v_registers_[0] + addr; };
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenJPREG(uint16_t addr, uint8_t reg_x) {
+  return [addr, reg_x](CpuChip8Impl* cpu) {
+    cpu->program_counter_ = cpu->v_registers_[Quirks::kJumpVx ? reg_x : 0] + addr;
+  };
 }
-CpuChip8::Instruction CpuChip8::GenRND(uint8_t reg_x, uint8_t val) {
-  return [this, reg_x, val]() {
-    v_registers_[reg_x] = (rand() % 256) & val;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenRND(uint8_t reg_x, uint8_t val) {
+  return [reg_x, val](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg_x] = (cpu->rng_() % 256) & val;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenDRAW(uint8_t reg_x, uint8_t reg_y, uint8_t n_rows) {
-  return [this, reg_x, reg_y, n_rows]() {
-    uint8_t x_coord = v_registers_[reg_x];
-    uint8_t y_coord = v_registers_[reg_y];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenDRAW(uint8_t reg_x, uint8_t reg_y, uint8_t n_rows) {
+  return [reg_x, reg_y, n_rows](CpuChip8Impl* cpu) {
+    uint8_t x_coord = cpu->v_registers_[reg_x];
+    uint8_t y_coord = cpu->v_registers_[reg_y];
     DBG("DRAW %d rows at c,r %d,%d\t", n_rows, x_coord, y_coord);
     // Width always 8 pix (1 bpp so 1 byte)
     // Height is the 4-bit n_rows, so in total read n_rows bytes from mem[I]
-    bool pixels_unset = frame_.XORSprite(x_coord, y_coord, n_rows,
-      memory_ + index_register_);
-    v_registers_[0xF] = pixels_unset;
+    bool pixels_unset = cpu->DrawSprite(x_coord, y_coord, n_rows, 1);
+    cpu->v_registers_[0xF] = pixels_unset;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSKEY(uint8_t reg) {
-  return [this, reg]() {
-    keypad_state_[v_registers_[reg]] ? SKIP : NEXT;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSKEY(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    int key = cpu->v_registers_[reg] & 0xF;
+    if (cpu->options_.latency) cpu->options_.latency->KeyRead(key, &cpu->frame_);
+    cpu->keypad_state_[key] ? SKIP : NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSNKEY(uint8_t reg) {
-  return [this, reg]() {
-    keypad_state_[v_registers_[reg]] ? NEXT : SKIP;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSNKEY(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    int key = cpu->v_registers_[reg] & 0xF;
+    if (cpu->options_.latency) cpu->options_.latency->KeyRead(key, &cpu->frame_);
+    cpu->keypad_state_[key] ? NEXT : SKIP;
   };
 }
-CpuChip8::Instruction CpuChip8::GenRDELAY(uint8_t reg) {
-  return [this, reg]() {
-    v_registers_[reg] = delay_timer_;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenRDELAY(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    cpu->v_registers_[reg] = cpu->delay_timer_;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenWAITKEY(uint8_t reg) {
-  return [this, reg]() {
-    throw std::runtime_error("Implement waitkey!");
-    NEXT;
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenWAITKEY(uint8_t reg) {
+  // Waits for a key to be pressed and released, like the COSMAC VIP, so a
+  // held key isn't read twice. Spins on the instruction meanwhile.
+  return [reg](CpuChip8Impl* cpu) {
+    if (cpu->waitkey_key_ < 0) {
+      for (int key = 0; key < 16; key++) {
+        if (cpu->keypad_state_[key]) {
+          cpu->waitkey_key_ = key;
+          if (cpu->options_.latency) cpu->options_.latency->KeyRead(key, &cpu->frame_);
+          break;
+        }
+      }
+    } else if (!cpu->keypad_state_[cpu->waitkey_key_]) {
+      if (cpu->options_.latency) cpu->options_.latency->KeyRead(cpu->waitkey_key_, &cpu->frame_);
+      cpu->v_registers_[reg] = cpu->waitkey_key_;
+      cpu->waitkey_key_ = -1;
+      NEXT;
+    }
   };
 }
-CpuChip8::Instruction CpuChip8::GenWDELAY(uint8_t reg) {
-  return [this, reg]() {
-    delay_timer_ = v_registers_[reg];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenWDELAY(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    cpu->delay_timer_ = cpu->v_registers_[reg];
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenWSOUND(uint8_t reg) {
-  return [this, reg]() {
-    sound_timer_ = v_registers_[reg];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenWSOUND(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    cpu->sound_timer_ = cpu->v_registers_[reg];
+    cpu->UpdateSound();
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenADDI(uint8_t reg) {
-  return [this, reg]() {
-    index_register_ += v_registers_[reg];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenADDI(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    cpu->index_register_ += cpu->v_registers_[reg];
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenLDSPRITE(uint8_t reg) {
-  return [this, reg]() {
-    uint8_t digit = v_registers_[reg];
-    index_register_ = 0x50 + (5 * digit);
-    DBG("LDSPRITE digit %d. I <== 0x%X", digit, 0x50 + (5 * digit));
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLDSPRITE(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    uint8_t digit = cpu->v_registers_[reg];
+    cpu->index_register_ = kFontStart + (5 * digit);
+    DBG("LDSPRITE digit %d. I <== 0x%X", digit, kFontStart + (5 * digit));
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSTBCD(uint8_t reg) {
-  return [this, reg]() {
-    uint8_t value = v_registers_[reg];
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSTBCD(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    uint8_t value = cpu->v_registers_[reg];
     uint8_t val_hunds = value / 100;
     uint8_t val_tens =  (value / 10) % 10;
     uint8_t val_ones =  (value % 100) % 10;
-    memory_[index_register_]     = val_hunds;
-    memory_[index_register_ + 1] = val_tens;
-    memory_[index_register_ + 2] = val_ones;
+    cpu->Store(cpu->index_register_, val_hunds);
+    cpu->Store(cpu->index_register_ + 1, val_tens);
+    cpu->Store(cpu->index_register_ + 2, val_ones);
     DBG("SETBCD val: %d res: %d%d%d", value, val_hunds, val_tens, val_ones);
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenSTREG(uint8_t reg) {
-  return [this, reg]() {
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSTREG(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
     for (uint8_t v = 0; v <= reg; v++) {
-      memory_[index_register_ + v] = v_registers_[v];
+      cpu->Store(cpu->index_register_ + v, cpu->v_registers_[v]);
     }
+    if (Quirks::kLoadStoreIncrementsI) cpu->index_register_ += reg + 1;
     NEXT;
   };
 }
-CpuChip8::Instruction CpuChip8::GenLDREG(uint8_t reg) {
-  return [this, reg]() {
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLDREG(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
     DBG("LDREG ");
     for (uint8_t v = 0; v <= reg; v++) {
-      DBG("(V%d <== M[%X] {%d})", v, index_register_ + v,
-        memory_[index_register_ + v]);
-      v_registers_[v] = memory_[index_register_ + v];
+      DBG("(V%d <== M[%X] {%d})", v, cpu->index_register_ + v,
+        cpu->Mem(cpu->index_register_ + v));
+      cpu->v_registers_[v] = cpu->Mem(cpu->index_register_ + v);
     }
+    if (Quirks::kLoadStoreIncrementsI) cpu->index_register_ += reg + 1;
     NEXT;
   };
 }
 
 
-void CpuChip8::DbgMem() {
-  for (int i = 0; i <= 0xFFF; i += 0x10) {
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSCROLLDOWN(uint8_t n) {
+  return [n](CpuChip8Impl* cpu) {
+    cpu->frame_.ScrollDown(n * cpu->Scale(), cpu->PlaneMask());
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSCROLLRIGHT() {
+  return [](CpuChip8Impl* cpu) {
+    cpu->frame_.ScrollRight(4 * cpu->Scale(), cpu->PlaneMask());
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSCROLLLEFT() {
+  return [](CpuChip8Impl* cpu) {
+    cpu->frame_.ScrollLeft(4 * cpu->Scale(), cpu->PlaneMask());
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenEXIT() {
+  // Spin on the exit instruction, the host decides when to stop.
+  return [](CpuChip8Impl* cpu) { DBG("EXIT"); };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLORES() {
+  return [](CpuChip8Impl* cpu) {
+    cpu->hires_ = false;
+    cpu->frame_.SetAll(0);
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenHIRES() {
+  return [](CpuChip8Impl* cpu) {
+    cpu->hires_ = true;
+    cpu->frame_.SetAll(0);
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenDRAW16(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    // 16x16 sprite, two bytes per row.
+    cpu->v_registers_[0xF] = cpu->DrawSprite(cpu->v_registers_[reg_x], cpu->v_registers_[reg_y], 16, 2);
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLDBIGSPRITE(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    cpu->index_register_ = kBigFontStart + 10 * (cpu->v_registers_[reg] & 0xF);
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSTRPL(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    std::memcpy(cpu->rpl_flags_, cpu->v_registers_, reg + 1);
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLDRPL(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    std::memcpy(cpu->v_registers_, cpu->rpl_flags_, reg + 1);
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSCROLLUP(uint8_t n) {
+  return [n](CpuChip8Impl* cpu) {
+    cpu->frame_.ScrollUp(n * cpu->Scale(), cpu->PlaneMask());
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenSTRANGE(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    // Stores Vx..Vy, in either direction, without changing I.
+    int step = reg_x <= reg_y ? 1 : -1;
+    for (int i = 0, v = reg_x; ; i++, v += step) {
+      cpu->Store(cpu->index_register_ + i, cpu->v_registers_[v]);
+      if (v == reg_y) break;
+    }
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLDRANGE(uint8_t reg_x, uint8_t reg_y) {
+  return [reg_x, reg_y](CpuChip8Impl* cpu) {
+    int step = reg_x <= reg_y ? 1 : -1;
+    for (int i = 0, v = reg_x; ; i++, v += step) {
+      cpu->v_registers_[v] = cpu->Mem(cpu->index_register_ + i);
+      if (v == reg_y) break;
+    }
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenLDILONG() {
+  return [](CpuChip8Impl* cpu) {
+    // The address is the following instruction word.
+    cpu->index_register_ = cpu->Mem(cpu->program_counter_ + 2) << 8 | cpu->Mem(cpu->program_counter_ + 3);
+    DBG("I <== 0x%X", cpu->index_register_);
+    cpu->program_counter_ += 4;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenPLANE(uint8_t planes) {
+  return [planes](CpuChip8Impl* cpu) {
+    cpu->planes_ = planes & 0x3;
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenAUDIO() {
+  return [](CpuChip8Impl* cpu) {
+    for (int i = 0; i < 16; i++) cpu->audio_pattern_[i] = cpu->Mem(cpu->index_register_ + i);
+    NEXT;
+  };
+}
+template <typename Variant, typename Quirks>
+typename CpuChip8Impl<Variant, Quirks>::Instruction CpuChip8Impl<Variant, Quirks>::GenPITCH(uint8_t reg) {
+  return [reg](CpuChip8Impl* cpu) {
+    cpu->pitch_ = cpu->v_registers_[reg];
+    NEXT;
+  };
+}
+
+
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::DbgMem() {
+  for (int i = 0; i < Variant::kMemorySize; i += 0x10) {
     DBG("\nMEM[%03X]: ", i);
     for (int j = 0; j < 0x10; j++) {
-      DBG("%#04x ", memory_[i + j]);
+      DBG("%#04x ", pristine_memory_->Read(i + j));
     }
   }
   DBG("\n");
 }
 
-void CpuChip8::DbgReg() {
+template <typename Variant, typename Quirks>
+void CpuChip8Impl<Variant, Quirks>::DbgReg() {
   DBG("\n [ ");
   for (int i = 0; i <= 0xF; i++) {
     DBG("(V%d %d) ", i, v_registers_[i]);
@@ -485,4 +1213,17 @@ void CpuChip8::DbgReg() {
   DBG("(delay %d) ", delay_timer_);
   DBG("(sound %d) ", sound_timer_);
   DBG("] ");
-}
\ No newline at end of file
+}
+
+template class CpuChip8Impl<Chip8Variant, LegacyQuirks>;
+template class CpuChip8Impl<Chip8Variant, CosmacQuirks>;
+template class CpuChip8Impl<Chip8Variant, SuperChipQuirks>;
+template class CpuChip8Impl<Chip8Variant, XoChipQuirks>;
+template class CpuChip8Impl<SuperChipVariant, LegacyQuirks>;
+template class CpuChip8Impl<SuperChipVariant, CosmacQuirks>;
+template class CpuChip8Impl<SuperChipVariant, SuperChipQuirks>;
+template class CpuChip8Impl<SuperChipVariant, XoChipQuirks>;
+template class CpuChip8Impl<XoChipVariant, LegacyQuirks>;
+template class CpuChip8Impl<XoChipVariant, CosmacQuirks>;
+template class CpuChip8Impl<XoChipVariant, SuperChipQuirks>;
+template class CpuChip8Impl<XoChipVariant, XoChipQuirks>;
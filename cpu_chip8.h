@@ -1,15 +1,22 @@
 #ifndef C8_CPU_CHIP8_H_
 #define C8_CPU_CHIP8_H_
 
-#include <unordered_map>
 #include <atomic>
 #include <thread>
 #include <functional>
+#include <mutex>
+#include <vector>
 
 #include "common.h"
 #include "image.h"
-
-// Emulates the CHIP-8 CPU in a background thread
+#include "latency_tracker.h"
+#include "metrics.h"
+#include "sound.h"
+
+// Emulates a CHIP-8 family CPU in a background thread.
+// This class is the host-facing half: options, pacing and the worker thread.
+// The machine itself is CpuChip8Impl<Variant, Quirks>, specialized at compile
+// time per machine variant and quirk set and picked by Create().
 // This class is not thread-safe -- calls to Start() and Stop() should
 // originate from the same thread.
 
@@ -22,15 +29,122 @@ class CpuChip8 {
     // How many instructions to execute between each vsync.
     static constexpr int kCyclesPerFrame = kCycleSpeedHz / kRefreshRateHz;
 
+    // Machine variants, see chip8_variant.h.
+    enum class Machine {
+      // Look the ROM up in Options::rom_database, kChip8 if not found.
+      kAuto,
+      // The original 64x32, 4K machine.
+      kChip8,
+      // SUPER-CHIP 1.1: 128x64 hi-res, scrolling, big font, RPL flags.
+      kSuperChip,
+      // XO-CHIP: SUPER-CHIP plus 64K memory, two bitplanes, 16-bit I loads.
+      kXoChip,
+    };
+
+    // Quirk sets for ambiguous opcodes, see chip8_quirks.h.
+    enum class QuirkSet {
+      // Look the ROM up in Options::rom_database, else the machine's default.
+      kAuto,
+      kLegacy,
+      kCosmac,
+      kSuperChip,
+      kXoChip,
+    };
+
+    // How instructions are dispatched. Engines must behave identically,
+    // chip8_verify runs them against each other, see verifier.h.
+    enum class Engine {
+      // One shared table of pre-decoded instructions, indexed by opcode.
+      kTable,
+      // Decodes every instruction as it runs it. Slow but direct, the
+      // reference faster engines are checked against.
+      kReference,
+    };
+
     struct Options {
       std::string rom_filename = "";
-      // Callbacks called by the CPU worker thread.
+      Machine machine = Machine::kAuto;
+      QuirkSet quirks = QuirkSet::kAuto;
+      Engine engine = Engine::kTable;
+      // Optional. Maps ROM hashes to machines and quirk sets, see rom_database.h.
+      std::string rom_database = "";
+      // Callbacks called by the CPU worker thread, or by RunFrame(). Both
+      // are optional for callers that step the CPU themselves.
       // Clears and fills 16-byte keypad_state_. Called once at kFreshRateHz.
       std::function<void(uint8_t*)> set_keypad_state_callback = nullptr;
       // Produces the CPU frame. Called as produced.
       std::function<void(Image*)> produce_frame_callback = nullptr;
+      // Optional. Receives sound timer on/off edges, the CPU never blocks
+      // on it. The consumer must drain it from a single thread.
+      SoundRing* sound_edges = nullptr;
+      // Optional. Updated by the CPU thread, never read by it.
+      Metrics* metrics = nullptr;
+      // Optional. Told when the keypad callback ran, when SKP, SKNP and FX0A
+      // read a key and when frames are produced.
+      LatencyTracker* latency = nullptr;
+      // Optional. Exports the frame, registers and a keypad input channel
+      // through a POSIX shared-memory segment of this name, e.g. "/chip8-0".
+      // See shm_export.h.
+      std::string shm_name = "";
+      // Seeds the RND instruction. Fixed by default so runs are reproducible.
+      uint32_t random_seed = 1;
+      // Log initialization info to stdout.
+      bool verbose = true;
     };
-    CpuChip8(const Options& options);
+
+    // Why the CPU stopped executing a ROM. A faulted CPU doesn't throw: it
+    // stays on the faulting instruction, re-running it every cycle like
+    // SUPER-CHIP's EXIT, until the next Boot(). Timers keep ticking.
+    enum class Fault : uint8_t {
+      kNone,
+      // No instruction for the opcode on this machine.
+      kUnknownOpcode,
+      // CALL with 16 return addresses already on the stack.
+      kStackOverflow,
+      // RET with an empty stack.
+      kStackUnderflow,
+    };
+
+    // The fault register. Only the first fault since Boot() is kept.
+    struct FaultInfo {
+      Fault fault;
+      // Address and opcode of the faulting instruction.
+      uint16_t pc;
+      uint16_t opcode;
+      // NumCycles() when it faulted.
+      uint64_t cycle;
+    };
+
+    // Snapshot of the architectural registers, packed for hashing.
+    struct Registers {
+      uint8_t v[16];
+      uint16_t index;
+      uint16_t pc;
+      uint16_t stack[16];
+      uint16_t sp;
+      uint8_t delay_timer;
+      uint8_t sound_timer;
+    };
+
+    // Creates the machine for options.machine and options.quirks. Each pair
+    // is its own instantiation, kAuto settings are resolved first.
+    static std::unique_ptr<CpuChip8> Create(const Options& options);
+    // Replaces kAuto machine and quirks with the ROM database entry for the
+    // ROM, or the defaults if there is none.
+    static void ResolveOptions(Options* options);
+    // Size of the frames produced by a resolved machine.
+    static void DisplaySize(Machine machine, int* cols, int* rows);
+    // Parses "auto", "chip8", "schip" or "xochip". Returns false if unknown.
+    static bool ParseMachine(const std::string& name, Machine* machine);
+    // Parses "auto", "legacy", "cosmac", "schip" or "xochip".
+    static bool ParseQuirkSet(const std::string& name, QuirkSet* quirks);
+    // Parses "table" or "reference".
+    static bool ParseEngine(const std::string& name, Engine* engine);
+    // "unknown opcode", "stack overflow", ..., for messages.
+    static const char* FaultName(Fault fault);
+    // One line describing the fault register, e.g. for logs.
+    static std::string DescribeFault(const FaultInfo& fault);
+    virtual ~CpuChip8() = default;
 
     // Begins emulation, executing kCycleSpeedHz instructions per second
     // in a background thread. Must call Stop() prior to destruction.
@@ -40,108 +154,100 @@ class CpuChip8 {
     // the background execution thread.
     void Stop();
 
-  private:
-    // Executes cycles until running_ becomes false.
-    void EmulationLoop();
-
-    // Resets all emulation state.
-    void Initialize();
-
-    // Loads a binary file ROM into memory.
-    void LoadROM(const std::string& filename);
-
-    // Emulate the next cycle.
-    void RunCycle();
-
-    void SetKeypadState(uint8_t (&state)[16]);
-
-    void BuildInstructionSet();
-
-    /// Instruction set implementation generators
-    using Instruction = std::function<void(void)>;
-    Instruction GenJP(uint16_t addr);
-    Instruction GenCALL(uint16_t addr);
-    Instruction GenSE(uint8_t reg, uint8_t val);
-    Instruction GenSNE(uint8_t reg, uint8_t val);
-    Instruction GenSEREG(uint8_t reg_x, uint8_t reg_y);
-    Instruction GenLDIMM(uint8_t reg, uint8_t val);
-    Instruction GenADDIMM(uint8_t reg, uint8_t val);
-    Instruction GenLDV(uint8_t reg_x, uint8_t reg_y);
-    Instruction GenOR(uint8_t reg_x, uint8_t reg_y);
-    Instruction GenAND(uint8_t reg_x, uint8_t reg_y);
-    Instruction GenXOR(uint8_t reg_x, uint8_t reg_y);
-    Instruction GenADD(uint8_t reg_x, uint8_t reg_y);
-    Instruction GenSUB(uint8_t reg_x, uint8_t reg_y);
-    Instruction GenSHR(uint8_t reg_x);
-    Instruction GenSUBN(uint8_t reg_x, uint8_t reg_y);
-    Instruction GenSHL(uint8_t reg_x);
-    Instruction GenSNEREG(uint8_t reg_x, uint8_t reg_y);
-    Instruction GenLDI(uint16_t addr);
-    Instruction GenJPREG(uint16_t addr);
-    Instruction GenRND(uint8_t reg, uint8_t val);
-    Instruction GenDRAW(uint8_t reg_x, uint8_t reg_y, uint8_t n_rows);
-    Instruction GenSKEY(uint8_t reg);
-    Instruction GenSNKEY(uint8_t reg);
-    Instruction GenRDELAY(uint8_t reg);
-    Instruction GenWAITKEY(uint8_t reg);
-    Instruction GenWDELAY(uint8_t reg);
-    Instruction GenWSOUND(uint8_t reg);
-    Instruction GenADDI(uint8_t reg);
-    Instruction GenLDSPRITE(uint8_t reg);
-    Instruction GenSTBCD(uint8_t reg);
-    Instruction GenSTREG(uint8_t reg);
-    Instruction GenLDREG(uint8_t reg);
-
-    void DbgMem();
-    void DbgReg();
-
-    const Options options_;
-
-    uint16_t current_opcode_;
-
-    // Map of opcodes to instructions. Built in Initialize().
-    // Each instruction is a fn pointer and two bytes. For 0xFFFF
-    // instructions this should be ~640kb, which should fit nicely in cache.
-    std::unordered_map<uint16_t, std::function<void(void)>> instructions_;
-
-    // Memory map:
-    // 0x000-0x1FF - Chip 8 interpreter (contains font set in emu)
-    // 0x050-0x0A0 - Used for the built in 4x5 pixel font set (0-F)
-    // 0x200-0xFFF - Program ROM and work RAM
-    uint8_t memory_[4096]; // 4K
-
-    // 15 8-bit general purpose registers named V0,V1 up to VE.
-    // The 16th register is used for the ‘carry flag’.
-    uint8_t v_registers_[16];
-
-    // Both range 0x000 to 0xFFF (12-bit)
-    uint16_t index_register_;
-    uint16_t program_counter_;
-
-    // Count down to 0 at 60hz when set.
-    uint8_t delay_timer_;
-    uint8_t sound_timer_;
-    // Number of cycles that have been executed.
-    uint64_t num_cycles_ = 0;
+    // Synchronous execution on the calling thread, for headless runners.
+    // Not to be mixed with Start() and Stop().
+    // Resets all emulation state and loads options.rom_filename.
+    void Boot();
+    // Same, but loads size bytes of ROM from memory.
+    void Boot(const uint8_t* rom, size_t size);
+
+    // Restarts the loaded ROM, or replaces it with size bytes from memory
+    // and starts that. Only the machine state is reset: the instruction
+    // tables and the worker thread stay, and memory is restored with one
+    // copy of a cached image of the font and ROM. While Start()ed, the
+    // worker applies it before its next frame and these return at once,
+    // otherwise it's applied before returning. LoadROM() throws if the ROM
+    // doesn't fit, leaving the current one loaded.
+    void Reset();
+    void LoadROM(const uint8_t* rom, size_t size);
+    // Polls the keypad, executes kCyclesPerFrame instructions and produces
+    // the frame. Does not sleep.
+    virtual void RunFrame() = 0;
+    // Executes n instructions, ticking the timers every kCyclesPerFrame.
+    // No callbacks are called.
+    virtual void RunCycles(int n) = 0;
+    // Sets the keypad, bit k for key k. The keypad callback overwrites it
+    // on the next RunFrame() if one was given.
+    virtual void SetKeypad(uint16_t keys) = 0;
+
+    // The current frame. Pixel values are bitmasks of the planes they are
+    // lit in, so always 0 or 1 on single-plane machines.
+    virtual Image* Frame() = 0;
+    // Copies length bytes of memory from address on, wrapping at the end.
+    virtual void ReadMemory(int address, int length, uint8_t* out) const = 0;
+    virtual int MemorySize() const = 0;
+    virtual Registers GetRegisters() const = 0;
+    virtual uint64_t NumCycles() const = 0;
+    // Fault::kNone unless the ROM faulted. Read it between frames, a host
+    // running untrusted ROMs can then drop the session.
+    virtual FaultInfo GetFault() const = 0;
+
+    // A copy of the machine for exploring from this state, see
+    // state_search.h. Memory pages are shared copy-on-write, only the
+    // registers and frame are copied. The fork keeps the machine, quirks,
+    // engine and seed of options_ but has no callbacks, metrics, export or
+    // debugger; step it with SetKeypad() and RunFrame() or RunCycles().
+    // Not while Start()ed. Forks can run on other threads.
+    virtual std::unique_ptr<CpuChip8> Fork() const = 0;
+    // Hash of everything but the keypad that decides how the machine runs
+    // on from here: registers, memory, frame, fault, display mode and RND
+    // state. Equal for equal states, so searches can skip states they've
+    // seen.
+    virtual uint64_t StateHash() const = 0;
+
+    // Debugger support, see debugger.h. Nothing here costs anything until
+    // SetDebugHook() is called, then only trapped instructions do.
+    // hook runs on the CPU thread before each trapped instruction and may
+    // block to pause the CPU there. Switches this instance to a private
+    // dispatch table, null switches back to the shared one. Must not be
+    // called from inside the hook.
+    virtual void SetDebugHook(std::function<void()> hook) = 0;
+    // Traps every instruction, for pausing and single-stepping. Safe to call
+    // while the CPU runs.
+    virtual void TrapAll(bool trap_all) = 0;
+    // Traps the instructions for these opcodes, untraps the rest. Only while
+    // the CPU is paused in the hook or not running.
+    virtual void SetTrappedOpcodes(const std::vector<uint16_t>& opcodes) = 0;
+
+  protected:
+    CpuChip8(const Options& options);
 
+    // Resets all emulation state and restores memory from the image built
+    // by SetROM().
+    virtual void Initialize() = 0;
 
-    uint16_t stack_[16];
-    // Points to the next empty spot.
-    uint16_t stack_pointer_;
+    // Builds the pristine memory image: fonts plus the binary ROM. Throws
+    // if it doesn't fit.
+    virtual void SetROM(const uint8_t* rom, size_t size) = 0;
 
-    // 0 when not pressed.
-    uint8_t keypad_state_[16];
+    const Options options_;
 
-    // Current working frame.
-    // 64x32 image. Each pixel either full-color or no-color.
-    // Drawing is done in XOR mode and if a pixel is turned off as a result of
-    // drawing, the VF register is set.
-    Image frame_;
+  private:
+    // Executes frames until running_ becomes false.
+    void EmulationLoop();
+    // Applies a Reset() or LoadROM() requested while running.
+    void ApplyPendingReset();
 
     // Background thread that performs emulation.
     std::thread cpu_thread_;
     // Set to true on Start() and false on Stop().
     std::atomic<bool> running_;
+
+    // Reset requested for the worker, checked once per frame.
+    std::atomic<bool> reset_pending_{false};
+    std::mutex pending_mu_;  // protects pending_rom_
+    // ROM to load with the pending reset, empty to keep the current one.
+    std::vector<uint8_t> pending_rom_;
 };
 
-#endif
\ No newline at end of file
+#endif
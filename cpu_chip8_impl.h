@@ -0,0 +1,245 @@
+#ifndef C8_CPU_CHIP8_IMPL_H_
+#define C8_CPU_CHIP8_IMPL_H_
+
+#include <atomic>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "common.h"
+#include "chip8_quirks.h"
+#include "chip8_variant.h"
+#include "cpu_chip8.h"
+#include "image.h"
+#include "paged_memory.h"
+#include "shm_export.h"
+
+// The machine state and instruction set of a CHIP-8 family CPU, specialized
+// on a variant from chip8_variant.h and a quirk policy from chip8_quirks.h.
+// Defined in cpu_chip8.cpp and explicitly instantiated there for every pair.
+
+template <typename Variant, typename Quirks>
+class CpuChip8Impl : public CpuChip8 {
+  public:
+    CpuChip8Impl(const Options& options);
+
+    void RunFrame() override;
+    void RunCycles(int n) override;
+    void SetKeypad(uint16_t keys) override;
+
+    Image* Frame() override { return &frame_; }
+    void ReadMemory(int address, int length, uint8_t* out) const override {
+      memory_.CopyOut(address & kAddressMask, length, out);
+    }
+    int MemorySize() const override { return Variant::kMemorySize; }
+    Registers GetRegisters() const override;
+    uint64_t NumCycles() const override { return num_cycles_; }
+    FaultInfo GetFault() const override { return fault_; }
+
+    std::unique_ptr<CpuChip8> Fork() const override;
+    uint64_t StateHash() const override;
+
+    void SetDebugHook(std::function<void()> hook) override;
+    void TrapAll(bool trap_all) override;
+    void SetTrappedOpcodes(const std::vector<uint16_t>& opcodes) override;
+
+  protected:
+    void Initialize() override;
+    void SetROM(const uint8_t* rom, size_t size) override;
+
+  private:
+    using Memory = PagedMemory<Variant::kMemorySize>;
+
+    // Fork() of other, see there for what's copied.
+    CpuChip8Impl(const CpuChip8Impl& other);
+
+    // Every memory access goes through this mask, so no address a ROM
+    // computes can leave memory_: 12 bits, 16 on XO-CHIP.
+    static constexpr int kAddressMask = Variant::kMemorySize - 1;
+    static constexpr int kStackDepth = 16;
+    // Largest DXYN read: 16x16 sprites in two planes.
+    static constexpr int kMaxSpriteBytes = 16 * 2 * Variant::kNumPlanes;
+
+    uint8_t Mem(int addr) const { return memory_.Read(addr & kAddressMask); }
+    // Copies the page first if it's shared with a fork.
+    void Store(int addr, uint8_t value) { memory_.Write(addr & kAddressMask, value); }
+
+    // Emulate the next cycle.
+    void RunCycle();
+
+    // Records fault unless one is already recorded. The instruction then
+    // returns without advancing the PC.
+    void RaiseFault(Fault fault);
+
+    // Publishes a sound edge if the sound timer crossed zero.
+    void UpdateSound();
+
+    /// Instruction set implementation generators
+    // Instructions don't capture the CPU, so every instance of a
+    // Variant/Quirks pair shares one table indexed by opcode. Opcodes without
+    // an instruction fault.
+    using Instruction = std::function<void(CpuChip8Impl*)>;
+    static const std::vector<Instruction>& InstructionSet();
+    static std::vector<Instruction> BuildInstructionSet();
+    // The instruction for one opcode, a fault for unknown ones.
+    static Instruction Decode(uint16_t opcode);
+    // Engine::kReference: every entry is DecodeAndRun(), so each cycle
+    // decodes afresh instead of using a pre-decoded table.
+    static const std::vector<Instruction>& ReferenceInstructionSet();
+    static void DecodeAndRun(CpuChip8Impl* cpu);
+    // Debug table entry: calls the hook, then the real instruction.
+    static void Trap(CpuChip8Impl* cpu);
+
+    // Bytes to advance to skip the next instruction. XO-CHIP's F000 NNNN is
+    // 4 bytes long.
+    int SkipLength() const;
+
+    // Plane mask for Image operations. kAllPlanes when every plane is
+    // selected so the image can move whole rows.
+    uint8_t PlaneMask() const;
+
+    // Pixel scale of the current display mode: 2 in SUPER-CHIP lo-res.
+    int Scale() const;
+
+    // XORs the sprite at I into every selected plane at display coords x,y.
+    // Returns whether any pixel was turned off.
+    bool DrawSprite(uint8_t x, uint8_t y, int rows, int bytes_per_row);
+
+    static Instruction GenJP(uint16_t addr);
+    static Instruction GenCALL(uint16_t addr);
+    static Instruction GenSE(uint8_t reg, uint8_t val);
+    static Instruction GenSNE(uint8_t reg, uint8_t val);
+    static Instruction GenSEREG(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenLDIMM(uint8_t reg, uint8_t val);
+    static Instruction GenADDIMM(uint8_t reg, uint8_t val);
+    static Instruction GenLDV(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenOR(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenAND(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenXOR(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenADD(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenSUB(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenSHR(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenSUBN(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenSHL(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenSNEREG(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenLDI(uint16_t addr);
+    static Instruction GenJPREG(uint16_t addr, uint8_t reg_x);
+    static Instruction GenRND(uint8_t reg, uint8_t val);
+    static Instruction GenDRAW(uint8_t reg_x, uint8_t reg_y, uint8_t n_rows);
+    static Instruction GenSKEY(uint8_t reg);
+    static Instruction GenSNKEY(uint8_t reg);
+    static Instruction GenRDELAY(uint8_t reg);
+    static Instruction GenWAITKEY(uint8_t reg);
+    static Instruction GenWDELAY(uint8_t reg);
+    static Instruction GenWSOUND(uint8_t reg);
+    static Instruction GenADDI(uint8_t reg);
+    static Instruction GenLDSPRITE(uint8_t reg);
+    static Instruction GenSTBCD(uint8_t reg);
+    static Instruction GenSTREG(uint8_t reg);
+    static Instruction GenLDREG(uint8_t reg);
+    // SUPER-CHIP
+    static Instruction GenSCROLLDOWN(uint8_t n);
+    static Instruction GenSCROLLRIGHT();
+    static Instruction GenSCROLLLEFT();
+    static Instruction GenEXIT();
+    static Instruction GenLORES();
+    static Instruction GenHIRES();
+    static Instruction GenDRAW16(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenLDBIGSPRITE(uint8_t reg);
+    static Instruction GenSTRPL(uint8_t reg);
+    static Instruction GenLDRPL(uint8_t reg);
+    // XO-CHIP
+    static Instruction GenSCROLLUP(uint8_t n);
+    static Instruction GenSTRANGE(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenLDRANGE(uint8_t reg_x, uint8_t reg_y);
+    static Instruction GenLDILONG();
+    static Instruction GenPLANE(uint8_t planes);
+    static Instruction GenAUDIO();
+    static Instruction GenPITCH(uint8_t reg);
+
+    void DbgMem();
+    void DbgReg();
+
+    uint16_t current_opcode_ = 0;
+
+    // Memory map:
+    // 0x000-0x1FF - Chip 8 interpreter (contains font set in emu)
+    // 0x050-0x0A0 - Used for the built in 4x5 pixel font set (0-F)
+    // 0x0A0-0x140 - SUPER-CHIP 8x10 pixel font set (0-F)
+    // 0x200-0xFFF - Program ROM and work RAM (to 0xFFFF on XO-CHIP)
+    Memory memory_;
+    // memory_ as it is at boot: fonts and ROM, built by SetROM() and shared
+    // with forks. Initialize() shares its pages into memory_.
+    std::shared_ptr<const Memory> pristine_memory_;
+
+    // 15 8-bit general purpose registers named V0,V1 up to VE.
+    // The 16th register is used for the ‘carry flag’.
+    uint8_t v_registers_[16] = {0};
+
+    // Both range 0x000 to 0xFFF (12-bit), 16-bit on XO-CHIP.
+    uint16_t index_register_ = 0;
+    uint16_t program_counter_ = 0;
+
+    // Count down to 0 at 60hz when set.
+    uint8_t delay_timer_ = 0;
+    uint8_t sound_timer_ = 0;
+    // Whether the last published sound edge was "on".
+    bool sound_on_ = false;
+    // Number of cycles that have been executed.
+    uint64_t num_cycles_ = 0;
+
+
+    uint16_t stack_[kStackDepth] = {0};
+    // Points to the next empty spot.
+    uint16_t stack_pointer_ = 0;
+
+    // 0 when not pressed.
+    uint8_t keypad_state_[16] = {0};
+    // Key FX0A saw pressed and waits to be released, -1 if none yet.
+    int8_t waitkey_key_ = -1;
+
+    FaultInfo fault_ = FaultInfo{Fault::kNone, 0, 0, 0};
+
+    // Per-instance generator so parallel instances stay deterministic.
+    std::minstd_rand rng_;
+
+    // SUPER-CHIP display mode. Always false on the base machine.
+    bool hires_ = false;
+    // SUPER-CHIP user flags, kept across resets like the HP48's.
+    uint8_t rpl_flags_[16] = {0};
+    // XO-CHIP bitplanes selected for drawing, 1 on other machines.
+    uint8_t planes_ = 1;
+    // XO-CHIP audio pattern and pitch. Recorded, but the square-wave audio
+    // path doesn't use them yet.
+    uint8_t audio_pattern_[16] = {0};
+    uint8_t pitch_ = 64;
+
+    // Shared-memory export, null unless Options::shm_name is set.
+    std::unique_ptr<ShmExport> shm_;
+
+    // Current working frame.
+    // kDisplayCols x kDisplayRows image. Each pixel holds the bitmask of the
+    // planes it is lit in.
+    // Drawing is done in XOR mode and if a pixel is turned off as a result of
+    // drawing, the VF register is set.
+    Image frame_;
+
+    // The table of Options::engine, shared with every other instance.
+    const std::vector<Instruction>* engine_instructions_;
+    // engine_instructions_, unless a debugger swapped in one of the tables
+    // below. Atomic so it can be
+    // swapped while running, the load is still a plain load on x86.
+    std::atomic<const std::vector<Instruction>*> instructions_;
+
+    // Debugger state, see SetDebugHook(). The tables are kept once built so
+    // a CPU leaving the hook never runs a freed entry.
+    std::function<void()> debug_hook_;
+    // Shared instructions with Trap() at the trapped opcodes.
+    std::unique_ptr<std::vector<Instruction>> trap_table_;
+    // Trap() everywhere.
+    std::unique_ptr<std::vector<Instruction>> trap_all_table_;
+    // Opcodes with Trap() in trap_table_.
+    std::vector<bool> trapped_;
+};
+
+#endif
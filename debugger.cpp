@@ -0,0 +1,419 @@
+#include "debugger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "common.h"
+#include "disassembler.h"
+
+constexpr int Debugger::kPageShift;
+
+namespace {
+std::string Format(const char* format, ...) {
+  char buffer[128];
+  va_list arglist;
+  va_start(arglist, format);
+  vsnprintf(buffer, sizeof(buffer), format, arglist);
+  va_end(arglist);
+  return buffer;
+}
+
+bool ParseHex(const std::string& str, int* value) {
+  try {
+    size_t end;
+    *value = std::stoi(str, &end, 16);
+    return end == str.size();
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+const char* kHelp =
+  "break <addr> [if <reg> <op> <value>]  reg v0-vf or i, op == != < > <= >=\n"
+  "delete <addr>\n"
+  "watch <addr> [len] [r|w|rw]\n"
+  "unwatch <addr>\n"
+  "list\n"
+  "pause | continue | step [count]\n"
+  "regs | mem <addr> [len] | dis [addr] [count]\n"
+  "Numbers are hex.\n";
+}
+
+Debugger::Debugger(CpuChip8* cpu, std::ostream& out) : cpu_(cpu), out_(out) {
+  watched_pages_.assign(cpu_->MemorySize() >> kPageShift, 0);
+  cpu_->SetDebugHook([this]() { OnTrap(); });
+}
+
+Debugger::~Debugger() {
+  repl_running_ = false;
+  if (repl_thread_.joinable()) {
+    #ifdef _WIN32
+    repl_thread_.detach();
+    #else
+    repl_thread_.join();
+    #endif
+  }
+  std::unique_lock<std::mutex> lock(mu_);
+  detaching_ = true;
+  // Park the CPU so it can't be entering a trap while the table switches.
+  pause_quietly_ = true;
+  PauseLocked(&lock);
+  cpu_->SetDebugHook(nullptr);
+  stopped_ = false;
+  cv_.notify_all();
+  cv_.wait(lock, [this]() { return in_trap_ == 0; });
+}
+
+void Debugger::StartRepl() {
+  repl_running_ = true;
+  repl_thread_ = std::thread([this]() {
+    std::string line;
+    while (repl_running_.load()) {
+      #ifndef _WIN32
+      // Poll so the destructor doesn't wait on a blocked read.
+      struct pollfd stdin_poll = {STDIN_FILENO, POLLIN, 0};
+      if (poll(&stdin_poll, 1, 100) <= 0) continue;
+      #endif
+      if (!std::getline(std::cin, line)) break;
+      std::string output = Execute(line);
+      const std::lock_guard<std::mutex> lock(mu_);
+      out_ << output << std::flush;
+    }
+  });
+}
+
+void Debugger::OnTrap() {
+  std::unique_lock<std::mutex> lock(mu_);
+  in_trap_++;
+  CpuChip8::Registers regs = cpu_->GetRegisters();
+  std::string reason = StopReason(regs, OpcodeAt(regs.pc));
+  if (!reason.empty() && !detaching_) {
+    stopped_ = true;
+    steps_left_ = 0;
+    // Not for the pause a command takes, so `list` can show what the
+    // running CPU traps.
+    if (!pause_quietly_) {
+      RearmBreakpointsLocked();
+      out_ << reason << " at " << Where(regs) << std::endl;
+    }
+    pause_requested_ = false;
+    pause_quietly_ = false;
+    cv_.notify_all();
+    cv_.wait(lock, [this]() { return !stopped_; });
+  }
+  in_trap_--;
+  cv_.notify_all();
+}
+
+std::string Debugger::StopReason(const CpuChip8::Registers& regs, uint16_t opcode) {
+  if (pause_requested_) return "Paused";
+  if (steps_left_ > 0 && --steps_left_ == 0) return "Stepped";
+  auto breakpoint = breakpoints_.find(regs.pc);
+  if (breakpoint != breakpoints_.end() && ConditionHolds(breakpoint->second.condition, regs)) {
+    return "Breakpoint";
+  }
+  int start, length;
+  bool write;
+  if (watchpoints_.empty() || !MemoryAccess(opcode, regs, &start, &length, &write)) return "";
+  bool page_watched = false;
+  for (int page = start >> kPageShift; page <= (start + length - 1) >> kPageShift; page++) {
+    page_watched |= watched_pages_[page % watched_pages_.size()] != 0;
+  }
+  if (!page_watched) return "";
+  for (const auto& watchpoint : watchpoints_) {
+    bool overlaps = watchpoint.first < start + length &&
+      start < watchpoint.first + watchpoint.second.length;
+    if (overlaps && (write ? watchpoint.second.write : watchpoint.second.read)) {
+      return Format("Watchpoint 0x%03X (%s)", watchpoint.first, write ? "write" : "read");
+    }
+  }
+  return "";
+}
+
+bool Debugger::MemoryAccess(uint16_t opcode, const CpuChip8::Registers& regs,
+    int* start, int* length, bool* write) {
+  uint8_t x = (opcode & 0x0F00) >> 8;
+  uint8_t y = (opcode & 0x00F0) >> 4;
+  uint8_t n = opcode & 0x000F;
+  *start = regs.index;
+  if ((opcode & 0xF0FF) == 0xF033) {
+    *length = 3;
+    *write = true;
+  } else if ((opcode & 0xF0FF) == 0xF055 || (opcode & 0xF0FF) == 0xF065) {
+    *length = x + 1;
+    *write = (opcode & 0xF0FF) == 0xF055;
+  } else if ((opcode & 0xF00F) == 0x5002 || (opcode & 0xF00F) == 0x5003) {
+    *length = (x > y ? x - y : y - x) + 1;
+    *write = (opcode & 0xF00F) == 0x5002;
+  } else if ((opcode & 0xF000) == 0xD000) {
+    // First plane only, DXY0 is a 16x16 sprite.
+    *length = n == 0 ? 32 : n;
+    *write = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool Debugger::ConditionHolds(const Condition& condition, const CpuChip8::Registers& regs) const {
+  if (condition.reg < 0) return true;
+  int value = condition.reg == 16 ? regs.index : regs.v[condition.reg];
+  const std::string& op = condition.op;
+  if (op == "==") return value == condition.value;
+  if (op == "!=") return value != condition.value;
+  if (op == "<") return value < condition.value;
+  if (op == ">") return value > condition.value;
+  if (op == "<=") return value <= condition.value;
+  return value >= condition.value;
+}
+
+bool Debugger::PauseLocked(std::unique_lock<std::mutex>* lock) {
+  if (stopped_) return true;
+  pause_requested_ = true;
+  cpu_->TrapAll(true);
+  // The CPU thread runs at least once a frame, unless it isn't running.
+  if (cv_.wait_for(*lock, std::chrono::seconds(1), [this]() { return stopped_; })) return true;
+  pause_requested_ = false;
+  pause_quietly_ = false;
+  cpu_->TrapAll(false);
+  return false;
+}
+
+void Debugger::ResumeLocked() {
+  cpu_->TrapAll(steps_left_ > 0);
+  stopped_ = false;
+  cv_.notify_all();
+}
+
+void Debugger::UpdateTrapsLocked() {
+  std::vector<uint16_t> opcodes;
+  for (auto& breakpoint : breakpoints_) {
+    breakpoint.second.opcode = OpcodeAt(breakpoint.first);
+    opcodes.push_back(breakpoint.second.opcode);
+  }
+  std::fill(watched_pages_.begin(), watched_pages_.end(), 0);
+  bool any_read = false, any_write = false;
+  for (const auto& watchpoint : watchpoints_) {
+    int last = watchpoint.first + watchpoint.second.length - 1;
+    for (int page = watchpoint.first >> kPageShift; page <= last >> kPageShift; page++) {
+      watched_pages_[page % watched_pages_.size()]++;
+    }
+    any_read |= watchpoint.second.read;
+    any_write |= watchpoint.second.write;
+  }
+  for (int x = 0; x < 16; x++) {
+    if (any_write) {
+      opcodes.push_back(0xF033 | x << 8);
+      opcodes.push_back(0xF055 | x << 8);
+    }
+    if (any_read) opcodes.push_back(0xF065 | x << 8);
+    for (int y = 0; y < 16; y++) {
+      if (any_write) opcodes.push_back(0x5002 | x << 8 | y << 4);
+      if (any_read) opcodes.push_back(0x5003 | x << 8 | y << 4);
+    }
+  }
+  // Every sprite draw reads memory, only trap them for read watchpoints.
+  if (any_read) {
+    for (int opcode = 0xD000; opcode <= 0xDFFF; opcode++) {
+      opcodes.push_back(opcode);
+    }
+  }
+  cpu_->SetTrappedOpcodes(opcodes);
+}
+
+void Debugger::RearmBreakpointsLocked() {
+  for (const auto& breakpoint : breakpoints_) {
+    if (OpcodeAt(breakpoint.first) != breakpoint.second.opcode) {
+      UpdateTrapsLocked();
+      return;
+    }
+  }
+}
+
+uint16_t Debugger::OpcodeAt(int address) const {
+  uint8_t bytes[2];
+  cpu_->ReadMemory(address, 2, bytes);
+  return bytes[0] << 8 | bytes[1];
+}
+
+std::string Debugger::Where(const CpuChip8::Registers& regs) const {
+  uint16_t opcode = OpcodeAt(regs.pc);
+  return Format("0x%03X: %04X  ", regs.pc, opcode) + Disassemble(opcode);
+}
+
+std::string Debugger::Registers() const {
+  CpuChip8::Registers regs = cpu_->GetRegisters();
+  std::string out;
+  for (int v = 0; v < 16; v++) {
+    out += Format("V%X=%02X%s", v, regs.v[v], v == 7 || v == 15 ? "\n" : " ");
+  }
+  out += Format("I=%03X PC=%03X SP=%X DT=%02X ST=%02X\n", regs.index, regs.pc, regs.sp,
+    regs.delay_timer, regs.sound_timer);
+  CpuChip8::FaultInfo fault = cpu_->GetFault();
+  if (fault.fault != CpuChip8::Fault::kNone) {
+    out += "FAULT: " + CpuChip8::DescribeFault(fault) + "\n";
+  }
+  return out;
+}
+
+std::string Debugger::Execute(const std::string& command) {
+  std::istringstream tokens(command);
+  std::string verb;
+  if (!(tokens >> verb)) return "";
+  if (verb == "help") return kHelp;
+
+  std::unique_lock<std::mutex> lock(mu_);
+  if (verb == "pause") {
+    return PauseLocked(&lock) ? "" : "CPU isn't running.\n";
+  } else if (verb == "continue" || verb == "c") {
+    if (!stopped_) return "Not stopped.\n";
+    steps_left_ = 0;
+    ResumeLocked();
+    return "";
+  } else if (verb == "step" || verb == "s") {
+    if (!stopped_) return "Not stopped.\n";
+    std::string count_str;
+    int count = 1;
+    if (tokens >> count_str && (!ParseHex(count_str, &count) || count < 1)) {
+      return "Bad count.\n";
+    }
+    steps_left_ = count;
+    ResumeLocked();
+    return "";
+  }
+
+  // Everything else reads or changes state the CPU thread uses, so hold it
+  // still. If it isn't running at all, there is nothing to race with.
+  bool was_stopped = stopped_;
+  if (!was_stopped) pause_quietly_ = true;
+  PauseLocked(&lock);
+  std::string out;
+  std::string arg;
+  int address = 0;
+  if (verb == "break" || verb == "b") {
+    Breakpoint breakpoint;
+    Condition& condition = breakpoint.condition;
+    std::string if_word, reg, value;
+    if (!(tokens >> arg) || !ParseHex(arg, &address)) {
+      out = "Usage: break <addr> [if <reg> <op> <value>]\n";
+    } else if (tokens >> if_word) {
+      int v;
+      if (if_word != "if" || !(tokens >> reg >> condition.op >> value) ||
+          !ParseHex(value, &condition.value)) {
+        out = "Usage: break <addr> [if <reg> <op> <value>]\n";
+      } else if (reg == "i" || reg == "I") {
+        condition.reg = 16;
+      } else if (reg.size() == 2 && (reg[0] == 'v' || reg[0] == 'V') &&
+                 ParseHex(reg.substr(1), &v)) {
+        condition.reg = v;
+      } else {
+        out = "Unknown register " + reg + "\n";
+      }
+      const std::string& op = condition.op;
+      if (out.empty() && op != "==" && op != "!=" && op != "<" && op != ">" &&
+          op != "<=" && op != ">=") {
+        out = "Unknown operator " + op + "\n";
+      }
+    }
+    if (out.empty()) {
+      breakpoints_[address] = breakpoint;
+      UpdateTrapsLocked();
+    }
+  } else if (verb == "delete" || verb == "d") {
+    if (!(tokens >> arg) || !ParseHex(arg, &address) || !breakpoints_.erase(address)) {
+      out = "No such breakpoint.\n";
+    } else {
+      UpdateTrapsLocked();
+    }
+  } else if (verb == "watch" || verb == "w") {
+    Watchpoint watchpoint{1, true, true};
+    std::string length_str, mode;
+    if (!(tokens >> arg) || !ParseHex(arg, &address) || address >= cpu_->MemorySize()) {
+      out = "Usage: watch <addr> [len] [r|w|rw]\n";
+    } else {
+      if (tokens >> length_str && (!ParseHex(length_str, &watchpoint.length) ||
+          watchpoint.length < 1)) {
+        out = "Bad length.\n";
+      }
+      if (tokens >> mode) {
+        watchpoint.read = mode.find('r') != std::string::npos;
+        watchpoint.write = mode.find('w') != std::string::npos;
+      }
+      watchpoint.length = std::min(watchpoint.length, cpu_->MemorySize() - address);
+    }
+    if (out.empty()) {
+      watchpoints_[address] = watchpoint;
+      UpdateTrapsLocked();
+    }
+  } else if (verb == "unwatch") {
+    if (!(tokens >> arg) || !ParseHex(arg, &address) || !watchpoints_.erase(address)) {
+      out = "No such watchpoint.\n";
+    } else {
+      UpdateTrapsLocked();
+    }
+  } else if (verb == "list" || verb == "l") {
+    for (const auto& breakpoint : breakpoints_) {
+      const Condition& condition = breakpoint.second.condition;
+      out += Format("break 0x%03X", breakpoint.first);
+      if (condition.reg == 16) {
+        out += Format(" if i %s %X", condition.op.c_str(), condition.value);
+      } else if (condition.reg >= 0) {
+        out += Format(" if v%x %s %X", condition.reg, condition.op.c_str(), condition.value);
+      }
+      uint16_t opcode = OpcodeAt(breakpoint.first);
+      if (opcode != breakpoint.second.opcode) {
+        out += Format("  rewritten to %04X, still trapping %04X until the next stop", opcode,
+          breakpoint.second.opcode);
+      }
+      out += "\n";
+    }
+    for (const auto& watchpoint : watchpoints_) {
+      out += Format("watch 0x%03X %X %s%s\n", watchpoint.first, watchpoint.second.length,
+        watchpoint.second.read ? "r" : "", watchpoint.second.write ? "w" : "");
+    }
+  } else if (verb == "regs" || verb == "r") {
+    out = Registers();
+  } else if (verb == "mem" || verb == "m") {
+    std::string length_str;
+    int length = 0x40;
+    if (!(tokens >> arg) || !ParseHex(arg, &address) ||
+        (tokens >> length_str && !ParseHex(length_str, &length))) {
+      out = "Usage: mem <addr> [len]\n";
+    } else {
+      std::vector<uint8_t> memory(std::max(length, 0));
+      cpu_->ReadMemory(address, length, memory.data());
+      for (int i = 0; i < length; i++) {
+        int at = (address + i) % cpu_->MemorySize();
+        if (i % 16 == 0) out += Format("%s%03X:", i ? "\n" : "", at);
+        out += Format(" %02X", memory[i]);
+      }
+      out += "\n";
+    }
+  } else if (verb == "dis") {
+    std::string count_str;
+    int count = 10;
+    address = cpu_->GetRegisters().pc;
+    if ((tokens >> arg && !ParseHex(arg, &address)) ||
+        (tokens >> count_str && !ParseHex(count_str, &count))) {
+      out = "Usage: dis [addr] [count]\n";
+    } else {
+      CpuChip8::Registers regs;
+      for (int i = 0; i < count; i++) {
+        regs.pc = (address + 2 * i) % cpu_->MemorySize();
+        out += Where(regs) + "\n";
+      }
+    }
+  } else {
+    out = "Unknown command " + verb + ", try help.\n";
+  }
+  if (!was_stopped && stopped_) ResumeLocked();
+  return out;
+}
@@ -0,0 +1,118 @@
+#ifndef C8_DEBUGGER_H_
+#define C8_DEBUGGER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "common.h"
+#include "cpu_chip8.h"
+
+// Interactive debugger for a running CPU: PC breakpoints with optional
+// register conditions, memory watchpoints, pause, single-step, and
+// register/memory/disassembly views.
+//
+// Nothing is checked per cycle. A breakpoint traps the opcode stored at its
+// address, so only instructions with that opcode call into the debugger,
+// which then compares the PC. The opcode at each breakpoint is looked up
+// again whenever the CPU stops, so code that rewrites the instruction at a
+// breakpoint is only caught after the next stop; `list` marks breakpoints
+// whose trapped opcode is out of date. Watchpoints trap the opcodes that
+// access memory through I, the writes (FX33, FX55, 5XY2) only if a
+// watchpoint watches writes and the reads (FX65, 5XY3, DXYN) only if one
+// watches reads, and check 256-byte page flags before comparing exact
+// ranges. Pausing and stepping trap every opcode until continued. When
+// stopped, the CPU thread blocks inside the trap.
+//
+// Commands, one per line, numbers in hex:
+//   break <addr> [if <reg> <op> <value>]   reg is v0-vf or i, op is == != < > <= >=
+//   delete <addr>
+//   watch <addr> [len] [r|w|rw]           defaults to 1 byte, rw
+//   unwatch <addr>
+//   list
+//   pause | continue | step [count]
+//   regs | mem <addr> [len] | dis [addr] [count]
+//   help
+
+class Debugger {
+  public:
+    // Attaches to cpu. Stops are reported on out.
+    Debugger(CpuChip8* cpu, std::ostream& out);
+    // Detaches, resuming the CPU if it is stopped.
+    ~Debugger();
+
+    // Runs one command, returns its output.
+    std::string Execute(const std::string& command);
+
+    // Reads commands from stdin on a background thread, printing to out.
+    void StartRepl();
+
+  private:
+    struct Condition {
+      // 0-15 for V0-VF, 16 for I. -1 for none.
+      int reg = -1;
+      std::string op;
+      int value = 0;
+    };
+    struct Breakpoint {
+      Condition condition;
+      // The opcode trapped for it, as of the last UpdateTrapsLocked().
+      uint16_t opcode = 0;
+    };
+    struct Watchpoint {
+      int length;
+      bool read;
+      bool write;
+    };
+
+    static constexpr int kPageShift = 8;
+
+    // Called on the CPU thread before each trapped instruction.
+    void OnTrap();
+    // Why the instruction at pc should stop the CPU, or "" to let it run.
+    std::string StopReason(const CpuChip8::Registers& regs, uint16_t opcode);
+    // Which memory an instruction accesses through I. False if none.
+    static bool MemoryAccess(uint16_t opcode, const CpuChip8::Registers& regs,
+      int* start, int* length, bool* write);
+    bool ConditionHolds(const Condition& condition, const CpuChip8::Registers& regs) const;
+
+    // Pauses the CPU if it is running. Returns false if it didn't stop in time.
+    bool PauseLocked(std::unique_lock<std::mutex>* lock);
+    void ResumeLocked();
+    // Re-traps the opcodes breakpoints and watchpoints need. Only while paused
+    // or in OnTrap().
+    void UpdateTrapsLocked();
+    // UpdateTrapsLocked() if an instruction at a breakpoint was rewritten.
+    void RearmBreakpointsLocked();
+
+    uint16_t OpcodeAt(int address) const;
+    std::string Where(const CpuChip8::Registers& regs) const;
+    std::string Registers() const;
+
+    CpuChip8* cpu_;
+    std::ostream& out_;
+
+    std::mutex mu_;  // protects everything below
+    std::condition_variable cv_;
+    // The CPU thread is blocked in OnTrap().
+    bool stopped_ = false;
+    bool pause_requested_ = false;
+    // Don't announce the pause, it's only to run a command.
+    bool pause_quietly_ = false;
+    // Instructions left to step, 0 when not stepping.
+    int steps_left_ = 0;
+    bool detaching_ = false;
+    // Threads inside OnTrap().
+    int in_trap_ = 0;
+    std::map<uint16_t, Breakpoint> breakpoints_;
+    std::map<uint16_t, Watchpoint> watchpoints_;
+    // Watchpoints per 256-byte page.
+    std::vector<uint8_t> watched_pages_;
+
+    std::thread repl_thread_;
+    std::atomic<bool> repl_running_{false};
+};
+
+#endif
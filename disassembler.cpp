@@ -0,0 +1,94 @@
+#include "disassembler.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+#include "common.h"
+
+namespace {
+std::string Format(const char* format, ...) {
+  char buffer[32];
+  va_list arglist;
+  va_start(arglist, format);
+  vsnprintf(buffer, sizeof(buffer), format, arglist);
+  va_end(arglist);
+  return buffer;
+}
+}
+
+std::string Disassemble(uint16_t opcode) {
+  uint16_t nnn = opcode & 0x0FFF;
+  uint8_t kk = opcode & 0x00FF;
+  uint8_t x = (opcode & 0x0F00) >> 8;
+  uint8_t y = (opcode & 0x00F0) >> 4;
+  uint8_t n = opcode & 0x000F;
+  switch (opcode & 0xF000) {
+    case 0x0000:
+      if (opcode == 0x00E0) return "CLS";
+      if (opcode == 0x00EE) return "RET";
+      if (opcode == 0x00FB) return "SCR";
+      if (opcode == 0x00FC) return "SCL";
+      if (opcode == 0x00FD) return "EXIT";
+      if (opcode == 0x00FE) return "LOW";
+      if (opcode == 0x00FF) return "HIGH";
+      if ((opcode & 0xFFF0) == 0x00C0) return Format("SCD %d", n);
+      if ((opcode & 0xFFF0) == 0x00D0) return Format("SCU %d", n);
+      break;
+    case 0x1000: return Format("JP 0x%03X", nnn);
+    case 0x2000: return Format("CALL 0x%03X", nnn);
+    case 0x3000: return Format("SE V%X, 0x%02X", x, kk);
+    case 0x4000: return Format("SNE V%X, 0x%02X", x, kk);
+    case 0x5000:
+      if (n == 0) return Format("SE V%X, V%X", x, y);
+      if (n == 2) return Format("SAVE V%X-V%X", x, y);
+      if (n == 3) return Format("LOAD V%X-V%X", x, y);
+      break;
+    case 0x6000: return Format("LD V%X, 0x%02X", x, kk);
+    case 0x7000: return Format("ADD V%X, 0x%02X", x, kk);
+    case 0x8000:
+      switch (n) {
+        case 0x0: return Format("LD V%X, V%X", x, y);
+        case 0x1: return Format("OR V%X, V%X", x, y);
+        case 0x2: return Format("AND V%X, V%X", x, y);
+        case 0x3: return Format("XOR V%X, V%X", x, y);
+        case 0x4: return Format("ADD V%X, V%X", x, y);
+        case 0x5: return Format("SUB V%X, V%X", x, y);
+        case 0x6: return Format("SHR V%X, V%X", x, y);
+        case 0x7: return Format("SUBN V%X, V%X", x, y);
+        case 0xE: return Format("SHL V%X, V%X", x, y);
+      }
+      break;
+    case 0x9000:
+      if (n == 0) return Format("SNE V%X, V%X", x, y);
+      break;
+    case 0xA000: return Format("LD I, 0x%03X", nnn);
+    case 0xB000: return Format("JP V0, 0x%03X", nnn);
+    case 0xC000: return Format("RND V%X, 0x%02X", x, kk);
+    case 0xD000: return Format("DRW V%X, V%X, %d", x, y, n);
+    case 0xE000:
+      if (kk == 0x9E) return Format("SKP V%X", x);
+      if (kk == 0xA1) return Format("SKNP V%X", x);
+      break;
+    case 0xF000:
+      if (opcode == 0xF000) return "LD I, long";
+      if (opcode == 0xF002) return "AUDIO";
+      switch (kk) {
+        case 0x01: return Format("PLANE %d", x);
+        case 0x07: return Format("LD V%X, DT", x);
+        case 0x0A: return Format("LD V%X, K", x);
+        case 0x15: return Format("LD DT, V%X", x);
+        case 0x18: return Format("LD ST, V%X", x);
+        case 0x1E: return Format("ADD I, V%X", x);
+        case 0x29: return Format("LD F, V%X", x);
+        case 0x30: return Format("LD HF, V%X", x);
+        case 0x33: return Format("LD B, V%X", x);
+        case 0x3A: return Format("PITCH V%X", x);
+        case 0x55: return Format("LD [I], V%X", x);
+        case 0x65: return Format("LD V%X, [I]", x);
+        case 0x75: return Format("LD R, V%X", x);
+        case 0x85: return Format("LD V%X, R", x);
+      }
+      break;
+  }
+  return Format("DW 0x%04X", opcode);
+}
@@ -0,0 +1,11 @@
+#ifndef C8_DISASSEMBLER_H_
+#define C8_DISASSEMBLER_H_
+
+#include "common.h"
+
+// Mnemonic for an opcode, e.g. "LD V3, 0x1F". Covers CHIP-8, SUPER-CHIP and
+// XO-CHIP, so some opcodes are only meaningful on some machines. Unknown
+// opcodes come back as "DW 0x1234".
+std::string Disassemble(uint16_t opcode);
+
+#endif
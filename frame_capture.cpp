@@ -0,0 +1,59 @@
+#include "frame_capture.h"
+
+#include <chrono>
+
+#include "common.h"
+
+namespace {
+// How often the write thread looks for new frames. Submit() doesn't wake
+// it, that would cost the CPU thread a syscall per frame.
+constexpr std::chrono::milliseconds kPollInterval(10);
+}
+
+FrameCapture::FrameCapture(CaptureRing* ring, const std::string& filename, int cols, int rows,
+    const Upscaler::Options& options, int num_threads, Metrics* metrics) :
+    cols_(cols), rows_(rows), options_(options), metrics_(metrics), ring_(ring),
+    output_(filename, std::ios::out | std::ios::binary), upscaler_(num_threads),
+    frame_(cols, rows) {
+  if (cols * rows > static_cast<int>(sizeof(CaptureFrame::pixels))) throw std::runtime_error("Frame too large to capture.");
+  Upscaler::Validate(options_);
+  if (!output_) throw std::runtime_error("Couldn't open " + filename);
+  rgb24_.resize(static_cast<size_t>(cols) * rows * options_.scale * options_.scale * 3);
+  thread_ = std::thread([this]() { WriteLoop(); });
+}
+
+FrameCapture::~FrameCapture() {
+  {
+    const std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  stop_cv_.notify_one();
+  thread_.join();
+}
+
+void FrameCapture::Submit(const Image& frame) {
+  CaptureFrame item;
+  std::memcpy(item.pixels, frame.Row(0), cols_ * rows_);
+  if (!ring_->Push(item)) {
+    num_dropped_.Add();
+    if (metrics_) metrics_->capture_frames_dropped.Add();
+  }
+}
+
+void FrameCapture::WriteLoop() {
+  bool stop = false;
+  while (!stop) {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      stop_cv_.wait_for(lock, kPollInterval, [this]() { return stop_; });
+      stop = stop_;
+    }
+    // After stop_, Submit() is done and this drains what it queued.
+    while (const CaptureFrame* item = ring_->Peek()) {
+      std::memcpy(frame_.Row(0), item->pixels, cols_ * rows_);
+      ring_->Pop();
+      upscaler_.Run(frame_, options_, rgb24_.data(), cols_ * options_.scale * 3);
+      output_.write(reinterpret_cast<const char*>(rgb24_.data()), rgb24_.size());
+    }
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef C8_FRAME_CAPTURE_H_
+#define C8_FRAME_CAPTURE_H_
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "common.h"
+#include "image.h"
+#include "metrics.h"
+#include "spsc_ring.h"
+#include "upscale.h"
+
+// One emulated frame's pixel values, sized for the largest display
+// (SUPER-CHIP and XO-CHIP high resolution).
+struct CaptureFrame {
+  uint8_t pixels[128 * 64];
+};
+// About a quarter second of frames. Owned by the caller, like SoundRing.
+using CaptureRing = SpscRing<CaptureFrame, 16>;
+
+// Records frames to a file as raw RGB24 video, upscaled. Submit() only
+// copies the emulated frame into the ring; upscaling and writing happen on
+// a background thread, so the CPU thread never waits on the disk. Frames
+// arriving while the ring is full are dropped and counted.
+
+class FrameCapture {
+  public:
+    // Throws if filename can't be opened or the options can't upscale.
+    // num_threads is passed on to the Upscaler. ring must outlive this.
+    FrameCapture(CaptureRing* ring, const std::string& filename, int cols, int rows,
+      const Upscaler::Options& options, int num_threads = 0, Metrics* metrics = nullptr);
+    // Writes the frames still queued and closes the file.
+    ~FrameCapture();
+
+    // Queues a copy of frame. Never blocks. Call from one thread only.
+    void Submit(const Image& frame);
+
+    uint64_t NumDropped() const { return num_dropped_.Value(); }
+
+  private:
+    void WriteLoop();
+
+    const int cols_;
+    const int rows_;
+    const Upscaler::Options options_;
+    Metrics* const metrics_;
+    Counter num_dropped_;
+    CaptureRing* const ring_;
+
+    // Owned by the write thread.
+    std::ofstream output_;
+    Upscaler upscaler_;
+    Image frame_;
+    std::vector<uint8_t> rgb24_;
+
+    std::mutex mu_; // protects stop_
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "golden.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "common.h"
+#include "cpu_chip8.h"
+#include "hash.h"
+#include "image.h"
+#include "sound.h"
+#include "wav_writer.h"
+
+namespace {
+std::string Dirname(const std::string& path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+// Paths in golden files are relative to the golden file.
+std::string Resolve(const std::string& golden_path, const std::string& path) {
+  return path[0] == '/' ? path : Dirname(golden_path) + path;
+}
+
+std::string FormatHash(uint64_t hash) {
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(hash));
+  return buf;
+}
+
+uint64_t HashState(CpuChip8* cpu, const GoldenCase& golden_case) {
+  Image* frame = cpu->Frame();
+  uint64_t hash = HashBytes(frame->Row(0), frame->Cols() * frame->Rows());
+  if (golden_case.hash_registers) {
+    CpuChip8::Registers regs = cpu->GetRegisters();
+    hash = HashBytes(&regs, sizeof(regs), hash);
+  }
+  if (golden_case.hash_memory) {
+    std::vector<uint8_t> memory(cpu->MemorySize());
+    cpu->ReadMemory(0, cpu->MemorySize(), memory.data());
+    hash = HashBytes(memory.data(), memory.size(), hash);
+  }
+  return hash;
+}
+}
+
+GoldenFile ParseGoldenFile(const std::string& path) {
+  std::ifstream input(path);
+  if (!input) {
+    throw std::runtime_error("Couldn't open golden file " + path);
+  }
+  GoldenFile file;
+  file.path = path;
+  std::string line;
+  while (std::getline(input, line)) {
+    file.lines.push_back(line);
+    int line_index = static_cast<int>(file.lines.size()) - 1;
+    std::string where = path + ":" + std::to_string(line_index + 1);
+
+    std::istringstream tokens(line.substr(0, line.find('#')));
+    std::string directive;
+    if (!(tokens >> directive)) continue;
+    if (directive == "rom") {
+      GoldenCase golden_case;
+      if (!(tokens >> golden_case.rom_filename)) {
+        throw std::runtime_error(where + ": rom needs a path.");
+      }
+      golden_case.rom_filename = Resolve(path, golden_case.rom_filename);
+      file.cases.push_back(golden_case);
+      continue;
+    }
+    if (file.cases.empty()) {
+      throw std::runtime_error(where + ": " + directive + " before rom.");
+    }
+    GoldenCase& golden_case = file.cases.back();
+    if (directive == "hash") {
+      std::string part;
+      while (tokens >> part) {
+        if (part == "regs") {
+          golden_case.hash_registers = true;
+        } else if (part == "mem") {
+          golden_case.hash_memory = true;
+        } else if (part != "frame") {
+          throw std::runtime_error(where + ": unknown hash part " + part);
+        }
+      }
+    } else if (directive == "machine") {
+      std::string name;
+      if (!(tokens >> name) || !CpuChip8::ParseMachine(name, &golden_case.machine)) {
+        throw std::runtime_error(where + ": expected machine <chip8|schip|xochip>");
+      }
+    } else if (directive == "quirks") {
+      std::string name;
+      if (!(tokens >> name) || !CpuChip8::ParseQuirkSet(name, &golden_case.quirks)) {
+        throw std::runtime_error(where + ": expected quirks <legacy|cosmac|schip|xochip>");
+      }
+    } else if (directive == "seed") {
+      if (!(tokens >> golden_case.seed)) {
+        throw std::runtime_error(where + ": seed needs a number.");
+      }
+    } else if (directive == "wav") {
+      if (!(tokens >> golden_case.wav_filename)) {
+        throw std::runtime_error(where + ": wav needs a path.");
+      }
+      golden_case.wav_filename = Resolve(path, golden_case.wav_filename);
+    } else if (directive == "key") {
+      GoldenKey key;
+      std::string state;
+      if (!(tokens >> key.frame >> std::hex >> key.key >> std::dec >> state) ||
+          key.key < 0 || key.key > 0xF || (state != "down" && state != "up")) {
+        throw std::runtime_error(where + ": expected key <frame> <0-F> <down|up>");
+      }
+      key.down = state == "down";
+      golden_case.keys.push_back(key);
+    } else if (directive == "check") {
+      GoldenCheck check;
+      std::string hash;
+      // A missing hash is fine, it gets filled in by --update.
+      if (!(tokens >> check.frame) || check.frame <= 0) {
+        throw std::runtime_error(where + ": expected check <frame> [hash]");
+      }
+      check.expected = (tokens >> hash) ? std::stoull(hash, nullptr, 16) : 0;
+      check.actual = 0;
+      check.line = line_index;
+      golden_case.checks.push_back(check);
+    } else {
+      throw std::runtime_error(where + ": unknown directive " + directive);
+    }
+  }
+
+  for (auto& golden_case : file.cases) {
+    std::stable_sort(golden_case.keys.begin(), golden_case.keys.end(),
+      [](const GoldenKey& a, const GoldenKey& b) { return a.frame < b.frame; });
+    std::stable_sort(golden_case.checks.begin(), golden_case.checks.end(),
+      [](const GoldenCheck& a, const GoldenCheck& b) { return a.frame < b.frame; });
+  }
+  return file;
+}
+
+void RunGoldenCase(GoldenCase* golden_case, bool run_all) {
+  golden_case->passed = true;
+  golden_case->errored = false;
+  golden_case->report.clear();
+  if (golden_case->checks.empty()) return;
+
+  uint8_t keypad[16] = {0};
+  CpuChip8::Options options;
+  options.rom_filename = golden_case->rom_filename;
+  options.machine = golden_case->machine;
+  options.quirks = golden_case->quirks;
+  options.random_seed = golden_case->seed;
+  options.verbose = false;
+  options.set_keypad_state_callback = [&keypad](uint8_t* cpu_keypad) {
+    std::memcpy(cpu_keypad, keypad, sizeof(keypad));
+  };
+  options.produce_frame_callback = [](Image*) {};
+  SoundRing sound_edges;
+  std::unique_ptr<WavWriter> wav;
+
+  std::ostringstream report;
+  try {
+    if (!golden_case->wav_filename.empty()) {
+      wav.reset(new WavWriter(golden_case->wav_filename, CpuChip8::kCycleSpeedHz));
+      options.sound_edges = &sound_edges;
+    }
+    std::unique_ptr<CpuChip8> cpu = CpuChip8::Create(options);
+    cpu->Boot();
+    auto key = golden_case->keys.begin();
+    auto check = golden_case->checks.begin();
+    for (int frame = 1; check != golden_case->checks.end(); frame++) {
+      for (; key != golden_case->keys.end() && key->frame <= frame; ++key) {
+        keypad[key->key] = key->down;
+      }
+      cpu->RunFrame();
+      if (wav) wav->Drain(&sound_edges, cpu->NumCycles());
+      for (; check != golden_case->checks.end() && check->frame == frame; ++check) {
+        check->actual = HashState(cpu.get(), *golden_case);
+        if (check->actual == check->expected || !golden_case->passed) continue;
+        golden_case->passed = false;
+        report << golden_case->rom_filename << ": first divergent frame " << frame
+               << ", expected " << FormatHash(check->expected)
+               << " got " << FormatHash(check->actual) << "\n";
+        if (cpu->GetFault().fault != CpuChip8::Fault::kNone) {
+          report << "  " << CpuChip8::DescribeFault(cpu->GetFault()) << "\n";
+        }
+        cpu->Frame()->DrawTo(report);
+        if (!run_all) {
+          golden_case->report = report.str();
+          return;
+        }
+      }
+    }
+  } catch (const std::exception& e) {
+    golden_case->passed = false;
+    golden_case->errored = true;
+    report << golden_case->rom_filename << ": ERROR: " << e.what() << "\n";
+  }
+  golden_case->report = report.str();
+}
+
+void WriteGoldenFile(const GoldenFile& file) {
+  std::vector<std::string> lines = file.lines;
+  for (const auto& golden_case : file.cases) {
+    for (const auto& check : golden_case.checks) {
+      lines[check.line] = "check " + std::to_string(check.frame) + " " +
+        FormatHash(check.actual);
+    }
+  }
+  std::ofstream output(file.path, std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Couldn't write golden file " + file.path);
+  }
+  for (const auto& line : lines) {
+    output << line << "\n";
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef C8_GOLDEN_H_
+#define C8_GOLDEN_H_
+
+#include "common.h"
+#include "cpu_chip8.h"
+
+// Golden-frame regression checks.
+//
+// A golden file lists cases. Each case runs a ROM headless with scripted
+// keypad input and compares a hash of the machine state against checked-in
+// values at chosen frames. One directive per line, '#' starts a comment:
+//
+//   rom roms/TETRIS      Starts a new case. Relative to the golden file.
+//   machine schip        chip8 (default), schip or xochip.
+//   quirks cosmac        legacy, cosmac, schip or xochip. Defaults to the
+//                        machine's own, legacy for chip8.
+//   hash frame regs mem  State that feeds the hash. Defaults to "frame".
+//   seed 7               RND seed. Defaults to 1.
+//   key 30 5 down        Before frame 30 runs, press key 0x5 ("up" releases).
+//   check 60 <hex hash>  Expected hash once 60 frames have run.
+//   wav out.wav          Also record the case's audio. Relative to the golden file.
+
+struct GoldenKey {
+  int frame;
+  int key;
+  bool down;
+};
+
+struct GoldenCheck {
+  int frame;
+  uint64_t expected;
+  uint64_t actual;
+  // Index into GoldenFile::lines, used when rewriting the file.
+  int line;
+};
+
+struct GoldenCase {
+  std::string rom_filename;
+  CpuChip8::Machine machine = CpuChip8::Machine::kChip8;
+  CpuChip8::QuirkSet quirks = CpuChip8::QuirkSet::kAuto;
+  bool hash_registers = false;
+  bool hash_memory = false;
+  uint32_t seed = 1;
+  std::string wav_filename;
+  // Both sorted by frame.
+  std::vector<GoldenKey> keys;
+  std::vector<GoldenCheck> checks;
+
+  // Filled in by RunGoldenCase().
+  bool passed = false;
+  // The ROM couldn't be run at all, so the actual hashes are meaningless.
+  bool errored = false;
+  std::string report;
+};
+
+struct GoldenFile {
+  std::string path;
+  std::vector<std::string> lines;
+  std::vector<GoldenCase> cases;
+};
+
+// Throws on unreadable files and malformed directives.
+GoldenFile ParseGoldenFile(const std::string& path);
+
+// Runs the case to its last checkpoint. Stops at the first divergent
+// checkpoint unless run_all is set, in which case every actual hash is filled.
+// On mismatch the report holds the frame number, both hashes and the frame.
+void RunGoldenCase(GoldenCase* golden_case, bool run_all);
+
+// Rewrites the file with the actual hashes of every check.
+void WriteGoldenFile(const GoldenFile& file);
+
+#endif
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "golden.h"
+
+// Runs golden files headless, one case per core at a time.
+// Usage: chip8_golden [--update] [-j threads] golden_file...
+
+int main(int argc, char* args[]) {
+  bool update = false;
+  unsigned num_threads = std::thread::hardware_concurrency();
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = args[i];
+    if (arg == "--update") {
+      update = true;
+    } else if (arg == "-j" && i + 1 < argc) {
+      num_threads = std::stoi(args[++i]);
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    std::cerr << "Usage: " << args[0] << " [--update] [-j threads] golden_file...\n";
+    return 2;
+  }
+
+  std::vector<GoldenFile> files;
+  std::vector<GoldenCase*> cases;
+  try {
+    for (const auto& path : paths) {
+      files.push_back(ParseGoldenFile(path));
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << "\n";
+    return 2;
+  }
+  for (auto& file : files) {
+    for (auto& golden_case : file.cases) {
+      cases.push_back(&golden_case);
+    }
+  }
+
+  std::atomic<size_t> next_case(0);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < std::max(1u, num_threads); t++) {
+    workers.emplace_back([&]() {
+      for (size_t i = next_case++; i < cases.size(); i = next_case++) {
+        RunGoldenCase(cases[i], update);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  if (update) {
+    for (const auto& file : files) {
+      bool errored = false;
+      for (const auto& golden_case : file.cases) {
+        errored |= golden_case.errored;
+      }
+      if (errored) {
+        std::cerr << "Not updating " << file.path << ", it has ROMs that failed to run.\n";
+        for (const auto& golden_case : file.cases) {
+          if (golden_case.errored) std::cerr << golden_case.report;
+        }
+        continue;
+      }
+      WriteGoldenFile(file);
+    }
+    std::cout << "Updated " << cases.size() << " cases.\n";
+    return 0;
+  }
+
+  int num_failed = 0;
+  for (const auto* golden_case : cases) {
+    if (golden_case->passed) continue;
+    num_failed++;
+    std::cout << golden_case->report;
+  }
+  std::cout << (cases.size() - num_failed) << "/" << cases.size() << " cases passed.\n";
+  return num_failed > 0 ? 1 : 0;
+}
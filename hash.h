@@ -0,0 +1,35 @@
+#ifndef C8_HASH_H_
+#define C8_HASH_H_
+
+#include "common.h"
+
+// 64-bit FNV-1a. Not cryptographic, just cheap and stable across platforms
+// so hashes can be checked in.
+
+constexpr uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = kHashSeed) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Eight bytes per step, for hashes of large buffers that only live in
+// memory, like CpuChip8::StateHash(). Not FNV and not stable across
+// platforms, never check these in.
+inline uint64_t HashWords(const void* data, size_t size, uint64_t hash = kHashSeed) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(word));
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 32;
+  }
+  return HashBytes(bytes + i, size - i, hash);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "cpu_chip8.h"
+#include "metrics.h"
+#include "session_host.h"
+
+// Load test for SessionHost: runs many real-time sessions of one ROM and
+// reports how well frame deadlines were kept.
+// Usage: chip8_host --rom <file> [--sessions n] [--threads n] [--seconds n]
+//   [--machine chip8|schip|xochip] [--no-pin] [--metrics <file>]
+
+int main(int argc, char* args[]) {
+  std::string rom_filename;
+  std::string metrics_filename;
+  int num_sessions = 1000;
+  int seconds = 10;
+  CpuChip8::Machine machine = CpuChip8::Machine::kChip8;
+  SessionHost::Options host_options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = args[i];
+    if (arg == "--rom" && i + 1 < argc) {
+      rom_filename = args[++i];
+    } else if (arg == "--sessions" && i + 1 < argc) {
+      num_sessions = std::stoi(args[++i]);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      host_options.num_threads = std::stoi(args[++i]);
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      seconds = std::stoi(args[++i]);
+    } else if (arg == "--machine" && i + 1 < argc) {
+      if (!CpuChip8::ParseMachine(args[++i], &machine)) {
+        std::cerr << "Unknown machine " << args[i] << "\n";
+        return 2;
+      }
+    } else if (arg == "--no-pin") {
+      host_options.pin_threads = false;
+    } else if (arg == "--metrics" && i + 1 < argc) {
+      metrics_filename = args[++i];
+    }
+  }
+  if (rom_filename.empty()) {
+    std::cerr << "Usage: " << args[0] << " --rom <file> [--sessions n] [--threads n] [--seconds n]"
+      " [--machine chip8|schip|xochip] [--no-pin] [--metrics <file>]\n";
+    return 2;
+  }
+  std::ifstream input(rom_filename, std::ios::in | std::ios::binary);
+  std::vector<uint8_t> rom(
+         (std::istreambuf_iterator<char>(input)),
+         (std::istreambuf_iterator<char>()));
+
+  Metrics metrics;
+  std::unique_ptr<MetricsDumper> metrics_dumper;
+  if (!metrics_filename.empty()) {
+    metrics_dumper.reset(new MetricsDumper(&metrics, metrics_filename));
+  }
+  host_options.metrics = &metrics;
+  host_options.error_callback = [](uint64_t id, const std::string& error) {
+    std::cerr << "Session " << id << " stopped: " << error << "\n";
+  };
+
+  try {
+    SessionHost host(host_options);
+    CpuChip8::Options cpu_options;
+    cpu_options.machine = machine;
+    cpu_options.metrics = &metrics;
+    cpu_options.verbose = false;
+    for (int i = 0; i < num_sessions; i++) {
+      cpu_options.random_seed = i + 1;
+      host.Add(cpu_options, rom.data(), rom.size());
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    std::cout << host.NumSessions() << " sessions, " << metrics.frames_produced.Value()
+      << " frames, " << metrics.dropped_frames.Value() << " dropped, "
+      << metrics.sessions_migrated.Value() << " migrated\n"
+      << "lateness us p50 " << metrics.frame_lateness_us.Percentile(0.5)
+      << " p99 " << metrics.frame_lateness_us.Percentile(0.99)
+      << " p99.9 " << metrics.frame_lateness_us.Percentile(0.999) << "\n";
+  } catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -1,8 +1,9 @@
 #include "image.h"
 #include "common.h"
 
+#include <algorithm>
 #include <iostream>
-#include <iomanip>
+#include <string>
 
 namespace { 
 void DBG(const char* str, ...) {
@@ -15,60 +16,131 @@ void DBG(const char* str, ...) {
 }
 }
 
-Image::Image(int cols, int rows) {
-  data_ = static_cast<uint8_t*>(std::malloc(cols * rows * sizeof(uint8_t)));
+Image::Image(int cols, int rows, uint8_t* data) {
+  owns_data_ = data == nullptr;
+  data_ = owns_data_ ? static_cast<uint8_t*>(std::malloc(cols * rows * sizeof(uint8_t))) : data;
   cols_ = cols;
   rows_ = rows;
 }
 
-uint8_t* Image::Row(int r) {
-  if (r < 0 || r >= rows_) {
-    throw std::runtime_error("Row out of bounds.");
+void Image::SetAll(uint8_t value) {
+  std::memset(data_, value, rows_ * cols_);
+}
+
+
+void Image::Clear(uint8_t planes) {
+  if (planes == kAllPlanes) {
+    SetAll(0);
+    return;
+  }
+  for (int i = 0; i < rows_ * cols_; i++) {
+    data_[i] &= ~planes;
   }
-  return &data_[r * cols_];
 }
 
-uint8_t& Image::At(int c, int r) {
-  if (c < 0 || c >= cols_) {
-    throw std::runtime_error("Column out of bounds.");
+template <bool kClip>
+bool Image::XORSprite(int c, int r, int height, const uint8_t* sprite,
+    int bytes_per_row, uint8_t plane, int scale) {
+  c %= cols_;
+  r %= rows_;
+  // The columns a sprite row covers are the same for every row: cut off at
+  // the right edge when clipping, otherwise possibly wrapping around it.
+  const int span = kClip ? std::min(8 * bytes_per_row * scale, cols_ - c)
+                         : 8 * bytes_per_row * scale;
+  const bool wraps = c + span > cols_;
+  // Every pixel value the sprite touched, before toggling.
+  uint8_t touched = 0;
+  for (int y = 0; y < height; y++) {
+    const uint8_t* sprite_row = sprite + y * bytes_per_row;
+    DBG("%X ", sprite_row[0]);
+    for (int dy = 0; dy < scale; dy++) {
+      int current_r = r + y * scale + dy;
+      if (kClip && current_r >= rows_) return (touched & plane) != 0;
+      uint8_t* row = Row(current_r % rows_);
+      // Note: We scan from MSbit to LSbit
+      for (int x = 0; x * scale < span; x++) {
+        if (!(sprite_row[x / 8] & (0x80 >> (x % 8)))) continue;
+        int end = std::min((x + 1) * scale, span);
+        if (wraps) {
+          for (int i = x * scale; i < end; i++) {
+            uint8_t& pixel = row[(c + i) % cols_];
+            touched |= pixel;
+            pixel ^= plane;
+          }
+        } else {
+          for (uint8_t* pixel = row + c + x * scale; pixel < row + c + end; pixel++) {
+            touched |= *pixel;
+            *pixel ^= plane;
+          }
+        }
+      }
+    }
   }
-  return Row(r)[c];
+  return (touched & plane) != 0;
 }
 
-void Image::SetAll(uint8_t value) {
-  std::memset(data_, value, rows_ * cols_);
+template bool Image::XORSprite<false>(int, int, int, const uint8_t*, int, uint8_t, int);
+template bool Image::XORSprite<true>(int, int, int, const uint8_t*, int, uint8_t, int);
+
+void Image::MoveRow(int dst, int src, uint8_t planes) {
+  uint8_t* dst_row = Row(dst);
+  const uint8_t* src_row = (src >= 0 && src < rows_) ? Row(src) : nullptr;
+  if (planes == kAllPlanes) {
+    if (src_row) {
+      std::memcpy(dst_row, src_row, cols_);
+    } else {
+      std::memset(dst_row, 0, cols_);
+    }
+    return;
+  }
+  for (int c = 0; c < cols_; c++) {
+    dst_row[c] = (dst_row[c] & ~planes) | (src_row ? src_row[c] & planes : 0);
+  }
 }
 
+void Image::ScrollDown(int n, uint8_t planes) {
+  // Bottom-up so rows are read before they are overwritten.
+  for (int r = rows_ - 1; r >= 0; r--) {
+    MoveRow(r, r - n, planes);
+  }
+}
 
-bool Image::XORSprite(int c, int r, int height, uint8_t* sprite) {
-  // Wrap around the screen as we draw.
-  bool pixel_was_disabled = false;
-  int dots = 0;
-  for (int y = 0; y < height; y++) {
-    int current_r = r + y;
-    while (current_r >= rows_) { current_r -= rows_; }
-    uint8_t sprite_byte = sprite[y];
-    DBG("%X ", sprite_byte);
-    for (int x = 0; x < 8; x++) {
-      int current_c = c + x;
-      while (current_c >= cols_) { current_c -= cols_; }
-      // Note: We scan from MSbit to LSbit
-      uint8_t sprite_val = (sprite_byte & (0x80 >> x)) >> (7-x);
-      if (sprite_val > 0) {
-        dots++;
-      }
-      pixel_was_disabled |= XOR(current_c, current_r, sprite_val);
+void Image::ScrollUp(int n, uint8_t planes) {
+  for (int r = 0; r < rows_; r++) {
+    MoveRow(r, r + n, planes);
+  }
+}
+
+void Image::ScrollLeft(int n, uint8_t planes) {
+  n = std::min(n, cols_);
+  for (int r = 0; r < rows_; r++) {
+    uint8_t* row = Row(r);
+    if (planes == kAllPlanes) {
+      std::memmove(row, row + n, cols_ - n);
+      std::memset(row + cols_ - n, 0, n);
+      continue;
+    }
+    for (int c = 0; c < cols_; c++) {
+      uint8_t src = c + n < cols_ ? row[c + n] & planes : 0;
+      row[c] = (row[c] & ~planes) | src;
     }
   }
-  DBG(" %d dots", dots);
-  return pixel_was_disabled;
 }
 
-bool Image::XOR(int c, int r, uint8_t val) {
-  uint8_t& current_val = At(c, r);
-  uint8_t prev_val = current_val;
-  current_val ^= val;
-  return current_val == 0 && prev_val > 0;
+void Image::ScrollRight(int n, uint8_t planes) {
+  n = std::min(n, cols_);
+  for (int r = 0; r < rows_; r++) {
+    uint8_t* row = Row(r);
+    if (planes == kAllPlanes) {
+      std::memmove(row + n, row, cols_ - n);
+      std::memset(row, 0, n);
+      continue;
+    }
+    for (int c = cols_ - 1; c >= 0; c--) {
+      uint8_t src = c - n >= 0 ? row[c - n] & planes : 0;
+      row[c] = (row[c] & ~planes) | src;
+    }
+  }
 }
 
  void Image::CopyToRGB24(uint8_t* dst, int red_scale, int green_scale, int blue_scale) {
@@ -82,30 +154,46 @@ bool Image::XOR(int c, int r, uint8_t val) {
   }
  }
 
+void Image::CopyToRGB24(uint8_t* dst, const uint8_t (*palette)[3]) {
+  for (int i = 0; i < rows_ * cols_; i++) {
+    std::memcpy(&dst[i * 3], palette[data_[i] & 0x3], 3);
+  }
+}
+
 void Image::Print() {
+  // Build the whole frame and write it once, rather than flushing per row.
+  std::string out;
+  out.reserve(rows_ * (cols_ * 4 + 1) + 1);
+  char pixel[8];
   for (int r = 0; r < rows_; r++) {
     for (int c = 0; c < cols_; c++) {
-      std::cout << std::setfill('0') << std::setw(3) << static_cast<int>(At(c,r)) << " ";
+      std::snprintf(pixel, sizeof(pixel), "%03d ", At(c, r));
+      out += pixel;
     }
-    std::cout << std::endl;
+    out += '\n';
   }
-  std::cout << std::endl;
+  out += '\n';
+  std::cout << out << std::flush;
 }
 
 void Image::DrawToStdout() {
+  DrawTo(std::cout);
+}
+
+void Image::DrawTo(std::ostream& out) {
+  std::string frame;
+  frame.reserve(rows_ * (cols_ + 1) + 1);
   for (int r = 0; r < rows_; r++) {
+    const uint8_t* row = Row(r);
     for (int c = 0; c < cols_; c++) {
-      if (At(c,r) > 0) {
-        std::cout << "X";
-      } else {
-        std::cout << " ";
-      }
+      frame += row[c] > 0 ? 'X' : ' ';
     }
-    std::cout << std::endl;
+    frame += '\n';
   }
-  std::cout << std::endl;
+  frame += '\n';
+  out << frame << std::flush;
 }
 
 Image::~Image() {
-  free(data_);
+  if (owns_data_) free(data_);
 }
\ No newline at end of file
@@ -3,47 +3,76 @@
 
 #include "common.h"
 
-// Monochrome image format.
+// Monochrome image format. Multi-plane machines store the bitmask of
+// lit planes in each pixel.
 
 class Image {
   public:
-    // Allocs and de-allocs in ctor and dtor.
-    Image(int cols, int rows);
+    // Plane mask covering every plane.
+    static constexpr uint8_t kAllPlanes = 0xFF;
+
+    // Allocs and de-allocs in ctor and dtor. If data is given the image
+    // draws into it instead, it must hold cols * rows bytes and outlive
+    // the image.
+    Image(int cols, int rows, uint8_t* data = nullptr);
     ~Image();
 
-    uint8_t* Row(int r);
+    // Unchecked, r and c must be in bounds. Drawing wraps or clips its
+    // coordinates before getting here.
+    uint8_t* Row(int r) { return &data_[r * cols_]; }
+    const uint8_t* Row(int r) const { return &data_[r * cols_]; }
 
     // Returns a pixel that can be changed.
-    uint8_t& At(int c, int r);
+    uint8_t& At(int c, int r) { return data_[r * cols_ + c]; }
     uint8_t& operator()(int c, int r) { return At(c, r); }
 
     void SetAll(uint8_t value);
+    // Clears the given planes of every pixel.
+    void Clear(uint8_t planes);
 
     // XOR render sprite to image starting at top-left corner c,r.
-    // c,r must be within the image. Up to 1-byte of width and up
-    // to height rows will be rendered, depending on the image bounds.
+    // The start coordinates wrap around the image. The rest of the sprite
+    // wraps too, or is cut off at the edges when kClip is set. Each row of
+    // the sprite is bytes_per_row bytes wide, each sprite pixel covers
+    // scale x scale image pixels and only the plane bit is toggled.
     // Returns whether or not any pixels were set to 0 by this operation.
-    bool XORSprite(int c, int r, int height, uint8_t* sprite);
+    // Instantiated in image.cpp for both values of kClip.
+    template <bool kClip = false>
+    bool XORSprite(int c, int r, int height, const uint8_t* sprite,
+      int bytes_per_row = 1, uint8_t plane = 1, int scale = 1);
+
+    // Shift the given planes by n pixels, filling with 0. Whole rows are
+    // moved at once when planes is kAllPlanes.
+    void ScrollDown(int n, uint8_t planes);
+    void ScrollUp(int n, uint8_t planes);
+    void ScrollLeft(int n, uint8_t planes);
+    void ScrollRight(int n, uint8_t planes);
 
-    int Cols() { return cols_; }
-    int Rows() { return rows_; }
+    int Cols() const { return cols_; }
+    int Rows() const { return rows_; }
 
     // The size of the allocated output buffer is exactly
     // Cols() * Rows() * 3.
     // Formatted interleaved RGBRGBRGB...
     void CopyToRGB24(uint8_t* dst, int red_scale, int green_scale, int blue_scale);
+    // Same layout, but maps each pixel value (0-3) through a palette.
+    void CopyToRGB24(uint8_t* dst, const uint8_t (*palette)[3]);
 
     void Print();
     void DrawToStdout();
+    // Same as DrawToStdout(), but to any stream.
+    void DrawTo(std::ostream& out);
 
   private:
-    // XOR a pixel with val. Returns true if the pixel was set to 0.
-    bool XOR(int c, int r, uint8_t val);
+    // Moves the planes of row src to row dst, or clears them if src is
+    // out of bounds. Shared by the vertical scrolls.
+    void MoveRow(int dst, int src, uint8_t planes);
 
     int cols_;
     int rows_;
 
     uint8_t* data_;
+    bool owns_data_;
 };
 
 #endif 
\ No newline at end of file
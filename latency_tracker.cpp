@@ -0,0 +1,69 @@
+#include "latency_tracker.h"
+
+#include <algorithm>
+
+#include "common.h"
+
+constexpr uint32_t LatencyTracker::kStageMask;
+constexpr std::chrono::seconds LatencyTracker::kStaleAfter;
+
+LatencyTracker::LatencyTracker(Metrics* metrics) : metrics_(metrics) {}
+
+void LatencyTracker::Advance(uint32_t state, Stage stage, Histogram* histogram) {
+  // Acquire pairs with the release in KeyEvent(): if this reads the next
+  // input's time, the swap below sees that input's claim and fails.
+  Clock::rep ticks = event_ticks_.load(std::memory_order_acquire);
+  if (!state_.compare_exchange_strong(state, (state & ~kStageMask) | stage)) return;
+  if (histogram) {
+    histogram->Record(std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - Clock::time_point(Clock::duration(ticks))).count());
+  }
+}
+
+void LatencyTracker::KeyEvent(int key, Clock::time_point time) {
+  uint32_t state = state_.load();
+  uint32_t claimed;
+  while (true) {
+    uint32_t stage = state & kStageMask;
+    // Headless frontends never present, so pixels counts as complete too.
+    bool complete = stage == kIdle || stage == kPixels;
+    if (!complete && time - Clock::time_point(Clock::duration(event_ticks_.load())) < kStaleAfter) {
+      return;
+    }
+    claimed = ((state & ~kStageMask) + kStageMask + 1) | kClaimed;
+    if (state_.compare_exchange_weak(state, claimed)) {
+      if (!complete) metrics_->inputs_abandoned.Add();
+      break;
+    }
+  }
+  key_.store(key, std::memory_order_release);
+  event_ticks_.store(time.time_since_epoch().count(), std::memory_order_release);
+  state_.store((claimed & ~kStageMask) | kEvent);
+}
+
+void LatencyTracker::KeypadApplied() {
+  uint32_t state = state_.load(std::memory_order_acquire);
+  if ((state & kStageMask) != kEvent) return;
+  Advance(state, kKeypad, &metrics_->input_to_keypad_us);
+}
+
+void LatencyTracker::KeyRead(int key, Image* frame) {
+  uint32_t state = state_.load(std::memory_order_acquire);
+  if ((state & kStageMask) != kKeypad || key != key_.load(std::memory_order_acquire)) return;
+  frame_size_ = std::min<int>(frame->Cols() * frame->Rows(), sizeof(frame_at_read_));
+  std::memcpy(frame_at_read_, frame->Row(0), frame_size_);
+  Advance(state, kRead, &metrics_->input_to_read_us);
+}
+
+void LatencyTracker::FrameProduced(Image* frame) {
+  uint32_t state = state_.load(std::memory_order_acquire);
+  if ((state & kStageMask) != kRead) return;
+  if (std::memcmp(frame->Row(0), frame_at_read_, frame_size_) == 0) return;
+  Advance(state, kPixels, &metrics_->input_to_pixels_us);
+}
+
+void LatencyTracker::Presented() {
+  uint32_t state = state_.load(std::memory_order_acquire);
+  if ((state & kStageMask) != kPixels) return;
+  Advance(state, kIdle, &metrics_->input_to_photon_us);
+}
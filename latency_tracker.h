@@ -0,0 +1,79 @@
+#ifndef C8_LATENCY_TRACKER_H_
+#define C8_LATENCY_TRACKER_H_
+
+#include <atomic>
+#include <chrono>
+
+#include "common.h"
+#include "image.h"
+#include "metrics.h"
+
+// Follows one key event at a time through the pipeline and records how long
+// each stage took after the event in Metrics:
+//   input_to_keypad_us   the keypad callback copied it into the CPU keypad
+//   input_to_read_us     the first SKP, SKNP or FX0A read that key
+//   input_to_pixels_us   the first frame produced after that read whose
+//                        pixels differ from the frame at the read
+//   input_to_photon_us   the first present of that frame
+// An input the game never reads or never answers on screen stops at that
+// stage. A new event replaces it once it's complete or a second old,
+// otherwise the new event isn't tracked. Replaced incomplete inputs count in
+// inputs_abandoned.
+//
+// KeyEvent() and Presented() are called by the UI thread, the rest by the
+// CPU thread; KeyEvent() by one thread at a time. Nothing takes a lock or
+// allocates: the stage is one atomic word and each thread moves it on with
+// a compare-and-swap, so a stage recorded against an input KeyEvent() just
+// replaced is dropped. Outside a tracked input each call is one atomic load.
+
+class LatencyTracker {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    LatencyTracker(Metrics* metrics);
+
+    // Key (0-15) went down or up at time.
+    void KeyEvent(int key, Clock::time_point time = Clock::now());
+    // The keypad callback has applied all events so far.
+    void KeypadApplied();
+    // An instruction read key. frame is the frame at that point.
+    void KeyRead(int key, Image* frame);
+    // A frame was produced and handed to the frontend.
+    void FrameProduced(Image* frame);
+    // The frontend presented the latest frame it was handed.
+    void Presented();
+
+  private:
+    enum Stage : uint32_t {
+      kIdle,
+      // KeyEvent() is replacing the input.
+      kClaimed,
+      kEvent,
+      kKeypad,
+      kRead,
+      kPixels,
+    };
+    // state_ is the Stage in the low bits and, above them, a count of
+    // tracked inputs, so a compare-and-swap from a replaced input's state
+    // fails even when the new input reached the same stage.
+    static constexpr uint32_t kStageMask = 0x7;
+    static constexpr std::chrono::seconds kStaleAfter{1};
+
+    // Moves state on to stage and records the time since the event in
+    // histogram, if set, unless the input changed since state was loaded.
+    void Advance(uint32_t state, Stage stage, Histogram* histogram);
+
+    Metrics* metrics_;
+    std::atomic<uint32_t> state_{kIdle};
+    // The tracked input, written by KeyEvent() between claiming and
+    // publishing it.
+    std::atomic<int> key_{0};
+    std::atomic<Clock::rep> event_ticks_{0};
+
+    // Only touched by the CPU thread. Frame pixels when the key was read,
+    // sized for the largest display.
+    uint8_t frame_at_read_[128 * 64];
+    int frame_size_ = 0;
+};
+
+#endif
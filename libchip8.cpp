@@ -0,0 +1,128 @@
+#include "libchip8.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "common.h"
+#include "cpu_chip8.h"
+#include "image.h"
+
+struct chip8 {
+  std::unique_ptr<CpuChip8> cpu;
+  bool loaded = false;
+  std::string last_error;
+};
+
+namespace {
+// Runs fn, turning exceptions into the handle's last error.
+template <typename Fn>
+int Guard(chip8* c8, Fn fn) {
+  try {
+    fn();
+    c8->last_error.clear();
+    return 0;
+  } catch (const std::exception& e) {
+    c8->last_error = e.what();
+    return -1;
+  }
+}
+}
+
+chip8* chip8_create(int machine, int quirks, uint32_t seed) {
+  CpuChip8::Options options;
+  switch (machine) {
+    case CHIP8_MACHINE_CHIP8: options.machine = CpuChip8::Machine::kChip8; break;
+    case CHIP8_MACHINE_SCHIP: options.machine = CpuChip8::Machine::kSuperChip; break;
+    case CHIP8_MACHINE_XOCHIP: options.machine = CpuChip8::Machine::kXoChip; break;
+    default: return nullptr;
+  }
+  switch (quirks) {
+    case CHIP8_QUIRKS_DEFAULT: options.quirks = CpuChip8::QuirkSet::kAuto; break;
+    case CHIP8_QUIRKS_LEGACY: options.quirks = CpuChip8::QuirkSet::kLegacy; break;
+    case CHIP8_QUIRKS_COSMAC: options.quirks = CpuChip8::QuirkSet::kCosmac; break;
+    case CHIP8_QUIRKS_SCHIP: options.quirks = CpuChip8::QuirkSet::kSuperChip; break;
+    case CHIP8_QUIRKS_XOCHIP: options.quirks = CpuChip8::QuirkSet::kXoChip; break;
+    default: return nullptr;
+  }
+  options.random_seed = seed;
+  options.verbose = false;
+  try {
+    std::unique_ptr<chip8> c8(new chip8);
+    c8->cpu = CpuChip8::Create(options);
+    return c8.release();
+  } catch (const std::exception&) {
+    return nullptr;
+  }
+}
+
+void chip8_destroy(chip8* c8) {
+  delete c8;
+}
+
+int chip8_load_rom(chip8* c8, const uint8_t* rom, size_t size) {
+  return Guard(c8, [c8, rom, size]() {
+    c8->cpu->Boot(rom, size);
+    c8->loaded = true;
+  });
+}
+
+int chip8_reset(chip8* c8) {
+  return Guard(c8, [c8]() {
+    if (!c8->loaded) throw std::runtime_error("No ROM loaded.");
+    c8->cpu->Reset();
+  });
+}
+
+int chip8_step_cycles(chip8* c8, uint32_t n) {
+  return Guard(c8, [c8, n]() {
+    if (!c8->loaded) throw std::runtime_error("No ROM loaded.");
+    // RunCycles() takes an int, so an n above INT_MAX runs in pieces.
+    uint32_t left = n;
+    while (left > 0) {
+      int chunk = static_cast<int>(std::min<uint32_t>(left, INT_MAX));
+      c8->cpu->RunCycles(chunk);
+      left -= chunk;
+    }
+  });
+}
+
+int chip8_step_frames(chip8* c8, uint32_t n) {
+  return Guard(c8, [c8, n]() {
+    if (!c8->loaded) throw std::runtime_error("No ROM loaded.");
+    for (uint32_t frame = 0; frame < n; frame++) {
+      c8->cpu->RunFrame();
+    }
+  });
+}
+
+void chip8_set_keys(chip8* c8, uint16_t keys) {
+  c8->cpu->SetKeypad(keys);
+}
+
+const uint8_t* chip8_framebuffer(chip8* c8, int* cols, int* rows) {
+  Image* frame = c8->cpu->Frame();
+  if (cols) *cols = frame->Cols();
+  if (rows) *rows = frame->Rows();
+  return frame->Row(0);
+}
+
+uint64_t chip8_cycles(const chip8* c8) {
+  return c8->cpu->NumCycles();
+}
+
+int chip8_fault(const chip8* c8, uint16_t* pc, uint16_t* opcode) {
+  CpuChip8::FaultInfo fault = c8->cpu->GetFault();
+  if (pc) *pc = fault.pc;
+  if (opcode) *opcode = fault.opcode;
+  switch (fault.fault) {
+    case CpuChip8::Fault::kNone: return CHIP8_FAULT_NONE;
+    case CpuChip8::Fault::kUnknownOpcode: return CHIP8_FAULT_UNKNOWN_OPCODE;
+    case CpuChip8::Fault::kStackOverflow: return CHIP8_FAULT_STACK_OVERFLOW;
+    case CpuChip8::Fault::kStackUnderflow: return CHIP8_FAULT_STACK_UNDERFLOW;
+  }
+  return CHIP8_FAULT_NONE;
+}
+
+const char* chip8_last_error(const chip8* c8) {
+  return c8->last_error.c_str();
+}
@@ -0,0 +1,83 @@
+#ifndef C8_LIBCHIP8_H_
+#define C8_LIBCHIP8_H_
+
+/* C interface to the emulator core, for embedding and language bindings.
+ * Built as libchip8.a and libchip8.so, neither needs SDL.
+ *
+ * Nothing runs in the background: the caller owns threading and pacing and
+ * drives the machine with chip8_step_cycles() and chip8_step_frames(), which
+ * return as soon as the instructions have executed. A handle must not be used
+ * from two threads at once, separate handles are independent.
+ *
+ * Functions returning int return 0 on success and -1 on failure, see
+ * chip8_last_error(). */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct chip8 chip8;
+
+enum {
+  CHIP8_MACHINE_CHIP8 = 0,
+  CHIP8_MACHINE_SCHIP = 1,
+  CHIP8_MACHINE_XOCHIP = 2,
+};
+
+enum {
+  /* The machine's own quirk set. */
+  CHIP8_QUIRKS_DEFAULT = 0,
+  CHIP8_QUIRKS_LEGACY = 1,
+  CHIP8_QUIRKS_COSMAC = 2,
+  CHIP8_QUIRKS_SCHIP = 3,
+  CHIP8_QUIRKS_XOCHIP = 4,
+};
+
+/* Returns null if machine or quirks is unknown. seed seeds RND. */
+chip8* chip8_create(int machine, int quirks, uint32_t seed);
+void chip8_destroy(chip8* c8);
+
+/* Resets the machine and loads size bytes of ROM, which are copied. */
+int chip8_load_rom(chip8* c8, const uint8_t* rom, size_t size);
+/* Resets the machine to the boot state of the last ROM, from a cached
+ * image rather than reloading it. */
+int chip8_reset(chip8* c8);
+
+/* Execute n instructions, or n frames of 9 instructions. Timers tick once
+ * every 9 instructions either way. Fail until a ROM is loaded. */
+int chip8_step_cycles(chip8* c8, uint32_t n);
+int chip8_step_frames(chip8* c8, uint32_t n);
+
+/* Bit k set holds key k down. Stays until changed. */
+void chip8_set_keys(chip8* c8, uint16_t keys);
+
+/* The framebuffer, cols * rows bytes, row-major. Each byte is the bitmask of
+ * the planes the pixel is lit in. Valid until chip8_destroy(), and updated
+ * in place as the machine runs. All 0 before the first ROM. */
+const uint8_t* chip8_framebuffer(chip8* c8, int* cols, int* rows);
+
+uint64_t chip8_cycles(const chip8* c8);
+
+enum {
+  CHIP8_FAULT_NONE = 0,
+  CHIP8_FAULT_UNKNOWN_OPCODE = 1,
+  CHIP8_FAULT_STACK_OVERFLOW = 2,
+  CHIP8_FAULT_STACK_UNDERFLOW = 3,
+};
+
+/* The first fault since the ROM was loaded, CHIP8_FAULT_NONE if none. A
+ * faulted machine keeps re-running the faulting instruction, at pc with
+ * opcode, until reset. pc and opcode may be null. */
+int chip8_fault(const chip8* c8, uint16_t* pc, uint16_t* opcode);
+
+/* Message of the last failure on this handle, or "" if none. */
+const char* chip8_last_error(const chip8* c8);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/* Smoke test of the C interface, run by `make check`. Built as C so a
+ * header that stops compiling without a C++ compiler fails here first.
+ * Usage: libchip8_check rom frames expected_frame_hash */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libchip8.h"
+
+/* 64-bit FNV-1a, the same as HashBytes() in hash.h. */
+static uint64_t HashBytes(const uint8_t* bytes, size_t size) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static int ReadFile(const char* path, uint8_t* buffer, size_t capacity, size_t* size) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return -1;
+  *size = fread(buffer, 1, capacity, file);
+  fclose(file);
+  return 0;
+}
+
+int main(int argc, char* args[]) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s rom frames expected_frame_hash\n", args[0]);
+    return 2;
+  }
+  uint32_t frames = (uint32_t)strtoul(args[2], NULL, 10);
+  uint64_t expected = strtoull(args[3], NULL, 16);
+
+  static uint8_t rom[4096];
+  size_t rom_size;
+  if (ReadFile(args[1], rom, sizeof(rom), &rom_size) != 0) {
+    fprintf(stderr, "Couldn't open %s\n", args[1]);
+    return 1;
+  }
+
+  chip8* c8 = chip8_create(CHIP8_MACHINE_CHIP8, CHIP8_QUIRKS_DEFAULT, 0);
+  if (!c8) {
+    fprintf(stderr, "chip8_create failed\n");
+    return 1;
+  }
+  int failed = 0;
+  if (chip8_step_frames(c8, 1) != -1 || chip8_last_error(c8)[0] == '\0') {
+    fprintf(stderr, "chip8_step_frames before a ROM: expected an error\n");
+    failed = 1;
+  }
+  if (chip8_load_rom(c8, rom, rom_size) != 0) {
+    fprintf(stderr, "chip8_load_rom: %s\n", chip8_last_error(c8));
+    failed = 1;
+  }
+  if (!failed && chip8_step_frames(c8, frames) != 0) {
+    fprintf(stderr, "chip8_step_frames: %s\n", chip8_last_error(c8));
+    failed = 1;
+  }
+  if (!failed) {
+    int cols, rows;
+    const uint8_t* pixels = chip8_framebuffer(c8, &cols, &rows);
+    uint64_t hash = HashBytes(pixels, (size_t)cols * rows);
+    if (hash != expected) {
+      fprintf(stderr, "%s after %" PRIu32 " frames: frame hash %016" PRIx64 ", expected %016" PRIx64 "\n",
+        args[1], frames, hash, expected);
+      failed = 1;
+    } else if (chip8_cycles(c8) != (uint64_t)frames * 9) {
+      fprintf(stderr, "chip8_cycles: %" PRIu64 ", expected %" PRIu64 "\n",
+        chip8_cycles(c8), (uint64_t)frames * 9);
+      failed = 1;
+    }
+  }
+  chip8_destroy(c8);
+  if (!failed) printf("libchip8: ok\n");
+  return failed;
+}
@@ -4,20 +4,198 @@
 #include <chrono>
 #include <mutex>
 #include <thread>
+#include <atomic>
+#include <cctype>
+#include <csignal>
+#include <fstream>
 
 #include <SDL2/SDL.h>
 
 #include "image.h"
 #include "cpu_chip8.h"
+#include "debugger.h"
+#include "frame_capture.h"
+#include "latency_tracker.h"
+#include "metrics.h"
 #include "sdl_viewer.h"
+#include "sdl_audio.h"
+#include "sound.h"
+#include "term_renderer.h"
+#include "upscale.h"
 
 using Clock = std::chrono::steady_clock;
 
-void Run() {
-  int emulated_width = 64;
-  int emulated_height = 32;
+struct Flags {
+  std::string rom_filename = "/Users/river/code/chip8/roms/VERS";
+  // std::string rom_filename = "C:/Users/jrive/code/chip-8/roms/TETRIS";
+  // Periodically dumps runtime metrics, as JSON if the file ends in .json
+  // and Prometheus text otherwise.
+  std::string metrics_filename;
+  CpuChip8::Machine machine = CpuChip8::Machine::kAuto;
+  CpuChip8::QuirkSet quirks = CpuChip8::QuirkSet::kAuto;
+  // Optional ROM hash database for picking the machine and quirks.
+  std::string rom_database;
+  // Optional shared-memory export name, see shm_export.h.
+  std::string shm_name;
+  // Render to the terminal instead of a window.
+  bool headless = false;
+  // Attach the debugger, commands on stdin.
+  bool debug = false;
+  // Headless only: keypad keys to press in turn, as synthetic input for
+  // measuring latency, e.g. {4, 6}.
+  std::vector<int> inject_keys;
+  // Headless only: stop after this long, 0 to run until interrupted.
+  int seconds = 0;
+  // Upscale frames on the CPU, with upscale.filter, scanlines or grid set.
+  // The window's texture, or the capture, is upscale.scale times the
+  // frame size. upscale.palette is filled in later.
+  bool cpu_upscale = false;
+  Upscaler::Options upscale;
+  // Headless only: appends every frame, upscaled, to this file as raw
+  // RGB24 video.
+  std::string capture_filename;
+  // Workers the upscaler splits frames over besides the CPU thread.
+  int upscale_threads = 0;
+};
 
-  SDLViewer viewer("c8-emu", emulated_width, emulated_height, 8);
+namespace {
+// Background, plane 1, plane 2, both planes.
+const uint8_t kPalette[4][3] = {{0, 0, 0}, {255, 20, 20}, {20, 160, 255}, {255, 255, 255}};
+}
+
+namespace {
+volatile std::sig_atomic_t g_interrupted = 0;
+
+// The CHIP-8 key a key event is for, -1 if none. Keys 1-4, Q-R, A-F and
+// Z-V are keypad keys 0 to F, row by row.
+int KeypadIndex(const SDL_Event& e) {
+  if (e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) return -1;
+  static const SDL_Keycode kKeys[16] = {SDLK_1, SDLK_2, SDLK_3, SDLK_4, SDLK_q, SDLK_w, SDLK_e,
+    SDLK_r, SDLK_a, SDLK_s, SDLK_d, SDLK_f, SDLK_z, SDLK_x, SDLK_c, SDLK_v};
+  for (int key = 0; key < 16; key++) {
+    if (e.key.keysym.sym == kKeys[key]) return key;
+  }
+  return -1;
+}
+
+// Synthetic input holds each key this many frames, once every period.
+constexpr int kInjectPeriodFrames = 30;
+constexpr int kInjectHoldFrames = 6;
+
+// Prints the latency stages of tracked inputs, if there were any.
+void PrintLatency(const Metrics& metrics) {
+  struct Stage {
+    const char* name;
+    const Histogram* histogram;
+  };
+  const Stage stages[] = {
+    {"keypad", &metrics.input_to_keypad_us},
+    {"read", &metrics.input_to_read_us},
+    {"pixels", &metrics.input_to_pixels_us},
+    {"photon", &metrics.input_to_photon_us},
+  };
+  if (metrics.input_to_keypad_us.Count() == 0) return;
+  std::cout << "Input latency from key event, us:\n";
+  for (const Stage& stage : stages) {
+    std::cout << "  " << stage.name << "\tn=" << stage.histogram->Count()
+      << "\tp50 " << stage.histogram->Percentile(0.5)
+      << "\tp90 " << stage.histogram->Percentile(0.9)
+      << "\tp99 " << stage.histogram->Percentile(0.99) << "\n";
+  }
+  std::cout << "  abandoned\t" << metrics.inputs_abandoned.Value() << std::endl;
+}
+}
+
+// Runs without SDL, drawing into the terminal until interrupted.
+void RunHeadless(const Flags& flags) {
+  Metrics metrics;
+  std::unique_ptr<MetricsDumper> metrics_dumper;
+  if (!flags.metrics_filename.empty()) {
+    metrics_dumper.reset(new MetricsDumper(&metrics, flags.metrics_filename));
+  }
+  int emulated_width, emulated_height;
+  CpuChip8::DisplaySize(flags.machine, &emulated_width, &emulated_height);
+  TermRenderer renderer(emulated_width, emulated_height);
+
+  CaptureRing capture_frames;
+  std::unique_ptr<FrameCapture> capture;
+  if (!flags.capture_filename.empty()) {
+    Upscaler::Options upscale = flags.upscale;
+    upscale.palette = kPalette;
+    capture.reset(new FrameCapture(&capture_frames, flags.capture_filename, emulated_width,
+      emulated_height, upscale, flags.upscale_threads, &metrics));
+    std::cerr << "Capturing " << emulated_width * upscale.scale << "x"
+      << emulated_height * upscale.scale << " RGB24 at " << CpuChip8::kRefreshRateHz
+      << " fps to " << flags.capture_filename << std::endl;
+  }
+
+  CpuChip8::Options cpu_options;
+  cpu_options.rom_filename = flags.rom_filename;
+  cpu_options.machine = flags.machine;
+  cpu_options.quirks = flags.quirks;
+  cpu_options.shm_name = flags.shm_name;
+  cpu_options.metrics = &metrics;
+  cpu_options.verbose = false;
+  cpu_options.produce_frame_callback = [&renderer, &capture](Image* cpu_img) {
+    renderer.Submit(cpu_img);
+    if (capture) capture->Submit(*cpu_img);
+  };
+  LatencyTracker latency(&metrics);
+  if (!flags.inject_keys.empty()) cpu_options.latency = &latency;
+  int frame = 0;
+  cpu_options.set_keypad_state_callback = [&flags, &latency, &frame](uint8_t* cpu_keypad) {
+    if (flags.inject_keys.empty()) return;
+    int phase = frame % kInjectPeriodFrames;
+    int key = flags.inject_keys[(frame / kInjectPeriodFrames) % flags.inject_keys.size()];
+    if (phase == 0 || phase == kInjectHoldFrames) {
+      latency.KeyEvent(key);
+      cpu_keypad[key] = phase == 0;
+    }
+    frame++;
+  };
+  std::unique_ptr<CpuChip8> cpu = CpuChip8::Create(cpu_options);
+
+  std::signal(SIGINT, [](int) { g_interrupted = 1; });
+  cpu->Start();
+  std::unique_ptr<Debugger> debugger;
+  if (flags.debug) {
+    debugger.reset(new Debugger(cpu.get(), std::cout));
+    debugger->StartRepl();
+  }
+  auto end_time = Clock::now() + std::chrono::seconds(flags.seconds);
+  while (!g_interrupted && (flags.seconds == 0 || Clock::now() < end_time)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  // Resumes the CPU if the debugger has it stopped.
+  debugger.reset();
+  cpu->Stop();
+  PrintLatency(metrics);
+  if (capture && capture->NumDropped() > 0) {
+    std::cerr << "Capture dropped " << capture->NumDropped() << " frames." << std::endl;
+  }
+}
+
+void Run(const Flags& flags) {
+  int emulated_width, emulated_height;
+  CpuChip8::DisplaySize(flags.machine, &emulated_width, &emulated_height);
+
+  Metrics metrics;
+  std::unique_ptr<MetricsDumper> metrics_dumper;
+  if (!flags.metrics_filename.empty()) {
+    metrics_dumper.reset(new MetricsDumper(&metrics, flags.metrics_filename));
+  }
+  LatencyTracker latency(&metrics);
+
+  // Same window size for every machine.
+  int window_scale = 512 / emulated_width;
+  Upscaler::Options upscale = flags.upscale;
+  upscale.palette = kPalette;
+  // Round the texture up to what the filter can make, the GPU fits it to
+  // the window.
+  int factor = Upscaler::Factor(upscale.filter);
+  upscale.scale = (window_scale + factor - 1) / factor * factor;
+  SDLViewer viewer("c8-emu", emulated_width, emulated_height, window_scale, &metrics,
+    flags.cpu_upscale ? &upscale : nullptr);
   std::mutex frame_mutex; // protects rgb24
   uint8_t* rgb24 = static_cast<uint8_t*>(std::calloc(
       emulated_width * emulated_height * 3, sizeof(uint8_t)));
@@ -26,84 +204,166 @@ void Run() {
   std::mutex events_mutex; // protects events
   std::vector<SDL_Event> events;
 
+  // Audio is optional, keep running on machines without a sound device.
+  SoundRing sound_edges;
+  std::unique_ptr<SDLAudio> audio;
+  try {
+    audio.reset(new SDLAudio(&sound_edges, CpuChip8::kCycleSpeedHz));
+  } catch (const std::exception& e) {
+    std::cerr << "No audio: " << e.what() << std::endl;
+  }
+
   CpuChip8::Options cpu_options;
-  cpu_options.rom_filename = "/Users/river/code/chip8/roms/VERS";
-  // cpu_options.rom_filename = "C:/Users/jrive/code/chip-8/roms/TETRIS";
+  cpu_options.rom_filename = flags.rom_filename;
+  cpu_options.machine = flags.machine;
+  cpu_options.quirks = flags.quirks;
+  cpu_options.shm_name = flags.shm_name;
+  cpu_options.metrics = &metrics;
+  cpu_options.latency = &latency;
   cpu_options.produce_frame_callback =
-    [emulated_height, rgb24, &frame_mutex, &viewer](Image* cpu_img) {
-      const std::lock_guard<std::mutex> frame_lock(frame_mutex);
-      cpu_img->CopyToRGB24(rgb24, 255, 20, 20);
-      viewer.SetFrameRGB24(rgb24, emulated_height);
-  }; 
+    [&flags, emulated_height, rgb24, &frame_mutex, &viewer](Image* cpu_img) {
+      if (flags.cpu_upscale) {
+        viewer.SetFrame(*cpu_img);
+      } else {
+        const std::lock_guard<std::mutex> frame_lock(frame_mutex);
+        cpu_img->CopyToRGB24(rgb24, kPalette);
+        viewer.SetFrameRGB24(rgb24, emulated_height);
+      }
+  };
   cpu_options.set_keypad_state_callback = [&events, &events_mutex](uint8_t* cpu_keypad) {
     const std::lock_guard<std::mutex> events_lock(events_mutex);
     for (const auto& e : events) {
-      if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
-        if (e.key.keysym.sym == SDLK_1) {                        
-          cpu_keypad[0] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_2) {                        
-          cpu_keypad[1] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_3) {                        
-          cpu_keypad[2] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_4) {                        
-          cpu_keypad[3] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_q) {                        
-          cpu_keypad[4] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_w) {                        
-          cpu_keypad[5] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_e) {                        
-          cpu_keypad[6] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_r) {                        
-          cpu_keypad[7] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_a) {                        
-          cpu_keypad[8] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_s) {                        
-          cpu_keypad[9] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_d) {                        
-          cpu_keypad[10] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_f) {                        
-          cpu_keypad[11] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_z) {                        
-          cpu_keypad[12] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_x) {                        
-          cpu_keypad[13] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_c) {                        
-          cpu_keypad[14] = e.type == SDL_KEYDOWN;
-        } else if (e.key.keysym.sym == SDLK_v) {                        
-          cpu_keypad[15] = e.type == SDL_KEYDOWN;
-        }
-      }
+      int key = KeypadIndex(e);
+      if (key >= 0) cpu_keypad[key] = e.type == SDL_KEYDOWN;
     }
+    // The keypad keeps its state, only changes need replaying.
+    events.clear();
   };
-  CpuChip8 cpu(cpu_options);
+  if (audio) cpu_options.sound_edges = &sound_edges;
+  std::unique_ptr<CpuChip8> cpu = CpuChip8::Create(cpu_options);
 
-  cpu.Start();
+  cpu->Start();
+  std::unique_ptr<Debugger> debugger;
+  if (flags.debug) {
+    debugger.reset(new Debugger(cpu.get(), std::cout));
+    debugger->StartRepl();
+  }
   bool quit = false;
   while (!quit) {
-    auto new_events = viewer.Update();
+    // Wakes for input or a new frame. The timeout only bounds how stale
+    // the fps in the title gets when nothing happens.
+    auto new_events = viewer.WaitEvents(250);
+    Clock::time_point arrived = Clock::now();
     for (const auto& e : new_events) {
       if (e.type == SDL_QUIT) {
         quit = true;
         continue;
       }
+      if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F5) {
+        // Restart the game in place.
+        cpu->Reset();
+        continue;
+      }
     }
 
     {
+      // Key events are recorded only once the keypad callback can see them,
+      // or the CPU could apply and read the old state ahead of them.
       const std::lock_guard<std::mutex> events_lock(events_mutex);
       events.insert(events.end(), new_events.begin(), new_events.end());
+      for (const auto& e : new_events) {
+        int key = KeypadIndex(e);
+        if (key >= 0 && !e.key.repeat) latency.KeyEvent(key, arrived);
+      }
     }
 
-    // Give the CPU thread time to run.
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (viewer.Present()) latency.Presented();
   }
-  cpu.Stop();
+  // Resumes the CPU if the debugger has it stopped.
+  debugger.reset();
+  cpu->Stop();
+  PrintLatency(metrics);
 
   free(rgb24);
 }
 
 int main(int argc, char* args[]) {
+  // Usage: chip8 [--rom <file>] [--machine auto|chip8|schip|xochip]
+  //   [--quirks auto|legacy|cosmac|schip|xochip] [--rom-db <file>] [--metrics <file>]
+  //   [--shm <name>] [--filter nearest|scale2x|scale3x] [--scanlines] [--grid]
+  //   [--headless [--inject-keys <hex digits>] [--seconds n] [--capture <file>]
+  //   [--capture-scale n] [--upscale-threads n]] [--debug]
+  Flags flags;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = args[i];
+    if (arg == "--rom" && i + 1 < argc) {
+      flags.rom_filename = args[++i];
+    } else if (arg == "--machine" && i + 1 < argc) {
+      if (!CpuChip8::ParseMachine(args[++i], &flags.machine)) {
+        std::cerr << "Unknown machine " << args[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--quirks" && i + 1 < argc) {
+      if (!CpuChip8::ParseQuirkSet(args[++i], &flags.quirks)) {
+        std::cerr << "Unknown quirks " << args[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--rom-db" && i + 1 < argc) {
+      flags.rom_database = args[++i];
+    } else if (arg == "--shm" && i + 1 < argc) {
+      flags.shm_name = args[++i];
+    } else if (arg == "--metrics" && i + 1 < argc) {
+      flags.metrics_filename = args[++i];
+    } else if (arg == "--inject-keys" && i + 1 < argc) {
+      for (char digit : std::string(args[++i])) {
+        int key = std::isxdigit(digit) ? std::stoi(std::string(1, digit), nullptr, 16) : -1;
+        if (key < 0) {
+          std::cerr << "Keys are hex digits: " << args[i] << std::endl;
+          return 1;
+        }
+        flags.inject_keys.push_back(key);
+      }
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      flags.seconds = std::stoi(args[++i]);
+    } else if (arg == "--filter" && i + 1 < argc) {
+      if (!Upscaler::ParseFilter(args[++i], &flags.upscale.filter)) {
+        std::cerr << "Unknown filter " << args[i] << std::endl;
+        return 1;
+      }
+      flags.cpu_upscale = true;
+    } else if (arg == "--scanlines") {
+      flags.upscale.scanline_level = 160;
+      flags.cpu_upscale = true;
+    } else if (arg == "--grid") {
+      flags.upscale.grid_level = 200;
+      flags.cpu_upscale = true;
+    } else if (arg == "--capture" && i + 1 < argc) {
+      flags.capture_filename = args[++i];
+    } else if (arg == "--capture-scale" && i + 1 < argc) {
+      flags.upscale.scale = std::stoi(args[++i]);
+    } else if (arg == "--upscale-threads" && i + 1 < argc) {
+      flags.upscale_threads = std::stoi(args[++i]);
+    } else if (arg == "--debug") {
+      flags.debug = true;
+    } else if (arg == "--headless") {
+      flags.headless = true;
+    }
+  }
   try {
-    Run();
+    // Settle the machine up front, the window size depends on it.
+    CpuChip8::Options resolved;
+    resolved.rom_filename = flags.rom_filename;
+    resolved.machine = flags.machine;
+    resolved.quirks = flags.quirks;
+    resolved.rom_database = flags.rom_database;
+    CpuChip8::ResolveOptions(&resolved);
+    flags.machine = resolved.machine;
+    flags.quirks = resolved.quirks;
+    if (flags.headless) {
+      RunHeadless(flags);
+    } else {
+      Run(flags);
+    }
     std::cout << "Exit main() success";
   } catch (const std::exception& e) {
     std::cerr << "ERROR: " << e.what();
@@ -0,0 +1,158 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "common.h"
+
+namespace {
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+void LowerThreadPriority() {
+  #ifdef __linux__
+  // Linux applies nice values per thread.
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+  #endif
+}
+}
+
+constexpr uint64_t Histogram::kMaxValue;
+
+int Histogram::Bucket(uint64_t value) {
+  if (value < 4) return static_cast<int>(value);
+  int msb = 63;
+  while (!(value >> msb)) msb--;
+  int sub = static_cast<int>((value >> (msb - 2)) & 3);
+  return 4 * (msb - 1) + sub;
+}
+
+uint64_t Histogram::BucketLowerBound(int bucket) {
+  if (bucket < 4) return bucket;
+  int msb = bucket / 4 + 1;
+  return static_cast<uint64_t>(4 + bucket % 4) << (msb - 2);
+}
+
+void Histogram::Record(uint64_t value) {
+  value = std::min(value, kMaxValue);
+  buckets_[Bucket(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::Percentile(double p) const {
+  uint64_t count = Count();
+  if (count == 0) return 0;
+  uint64_t rank = static_cast<uint64_t>(p * (count - 1)) + 1;
+  uint64_t seen = 0;
+  for (int b = 0; b < kNumBuckets; b++) {
+    seen += buckets_[b].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      // Midpoint of the bucket, exact for the small single-value buckets.
+      return BucketLowerBound(b) + (BucketLowerBound(b + 1) - BucketLowerBound(b)) / 2;
+    }
+  }
+  return BucketLowerBound(kNumBuckets - 1);
+}
+
+Metrics::Metrics() {
+  registry_ = {
+    {"chip8_cycles_executed_total", "Instructions executed.", &cycles_executed, nullptr},
+    {"chip8_frames_produced_total", "Frames produced.", &frames_produced, nullptr},
+    {"chip8_frames_presented_total", "Frames presented on screen.", &frames_presented, nullptr},
+    {"chip8_dropped_frames_total", "Frames that missed their vsync deadline.", &dropped_frames, nullptr},
+    {"chip8_frame_time_us", "Wall time spent emulating a frame.", nullptr, &frame_time_us},
+    {"chip8_oversleep_us", "Sleep overshoot of the CPU thread.", nullptr, &oversleep_us},
+    {"chip8_texture_upload_us", "Time to upload a frame to the GPU.", nullptr, &texture_upload_us},
+    {"chip8_input_to_keypad_us", "Key event to the CPU keypad.", nullptr, &input_to_keypad_us},
+    {"chip8_input_to_read_us", "Key event to the first instruction reading the key.", nullptr, &input_to_read_us},
+    {"chip8_input_to_pixels_us", "Key event to the first changed frame after the read.", nullptr, &input_to_pixels_us},
+    {"chip8_input_to_photon_us", "Key event to presenting the changed frame.", nullptr, &input_to_photon_us},
+    {"chip8_inputs_abandoned_total", "Tracked key events replaced before reaching the screen.", &inputs_abandoned, nullptr},
+    {"chip8_capture_frames_dropped_total", "Frames dropped because the capture writer fell behind.", &capture_frames_dropped, nullptr},
+    {"chip8_frame_lateness_us", "Frame start past its deadline on a session host.", nullptr, &frame_lateness_us},
+    {"chip8_sessions_migrated_total", "Sessions moved between host threads.", &sessions_migrated, nullptr},
+  };
+}
+
+std::string Metrics::ToPrometheus() const {
+  std::ostringstream out;
+  for (const auto& entry : registry_) {
+    out << "# HELP " << entry.name << " " << entry.help << "\n";
+    if (entry.counter) {
+      out << "# TYPE " << entry.name << " counter\n";
+      out << entry.name << " " << entry.counter->Value() << "\n";
+      continue;
+    }
+    out << "# TYPE " << entry.name << " summary\n";
+    for (double q : kQuantiles) {
+      out << entry.name << "{quantile=\"" << q << "\"} "
+          << entry.histogram->Percentile(q) << "\n";
+    }
+    out << entry.name << "_sum " << entry.histogram->Sum() << "\n";
+    out << entry.name << "_count " << entry.histogram->Count() << "\n";
+  }
+  return out.str();
+}
+
+std::string Metrics::ToJson() const {
+  std::ostringstream out;
+  out << "{";
+  for (size_t i = 0; i < registry_.size(); i++) {
+    const auto& entry = registry_[i];
+    out << (i > 0 ? ",\n " : "\n ") << "\"" << entry.name << "\": ";
+    if (entry.counter) {
+      out << entry.counter->Value();
+      continue;
+    }
+    out << "{\"count\": " << entry.histogram->Count()
+        << ", \"sum\": " << entry.histogram->Sum();
+    for (double q : kQuantiles) {
+      out << ", \"p" << q * 100 << "\": " << entry.histogram->Percentile(q);
+    }
+    out << "}";
+  }
+  out << "\n}\n";
+  return out.str();
+}
+
+MetricsDumper::MetricsDumper(const Metrics* metrics, const std::string& filename,
+    std::chrono::milliseconds interval) :
+    metrics_(metrics), filename_(filename), interval_(interval) {
+  thread_ = std::thread([this]() {
+    LowerThreadPriority();
+    std::unique_lock<std::mutex> lock(mu_);
+    while (!stop_cv_.wait_for(lock, interval_, [this]() { return stop_; })) {
+      Dump();
+    }
+  });
+}
+
+MetricsDumper::~MetricsDumper() {
+  {
+    const std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  stop_cv_.notify_one();
+  thread_.join();
+  Dump();
+}
+
+void MetricsDumper::Dump() {
+  bool json = filename_.size() >= 5 &&
+    filename_.compare(filename_.size() - 5, 5, ".json") == 0;
+  std::string tmp_filename = filename_ + ".tmp";
+  {
+    std::ofstream output(tmp_filename, std::ios::trunc);
+    output << (json ? metrics_->ToJson() : metrics_->ToPrometheus());
+    if (!output) return;
+  }
+  std::rename(tmp_filename.c_str(), filename_.c_str());
+}
@@ -0,0 +1,116 @@
+#ifndef C8_METRICS_H_
+#define C8_METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "common.h"
+
+// Runtime metrics. Updating a metric is a relaxed atomic add, so they are
+// safe to touch from the emulation thread; formatting and I/O only happen
+// on whichever thread reads them.
+
+class Counter {
+  public:
+    void Add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Distribution of non-negative integer samples. Buckets are powers of two
+// split into 4 linear steps, so percentiles are accurate to ~25%.
+class Histogram {
+  public:
+    // Larger samples are clamped.
+    static constexpr uint64_t kMaxValue = (1ULL << 62) - 1;
+    static constexpr int kNumBuckets = 244;
+
+    void Record(uint64_t value);
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+    // Approximate p-th percentile, p in [0, 1].
+    uint64_t Percentile(double p) const;
+
+  private:
+    static int Bucket(uint64_t value);
+    static uint64_t BucketLowerBound(int bucket);
+
+    std::atomic<uint64_t> buckets_[kNumBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+};
+
+// The emulator's metrics. Hand out a pointer to producers, read through the
+// public members or format everything with ToPrometheus()/ToJson().
+class Metrics {
+  public:
+    Metrics();
+
+    Counter cycles_executed;
+    Counter frames_produced;
+    // Frames the UI put on screen. Lower than frames_produced when the
+    // display can't keep up, identical frames are never presented twice.
+    Counter frames_presented;
+    // Frames that finished after their vsync deadline.
+    Counter dropped_frames;
+    // Wall time spent emulating each frame.
+    Histogram frame_time_us;
+    // How much longer than requested the CPU thread slept.
+    Histogram oversleep_us;
+    Histogram texture_upload_us;
+    // Stages of one key event at a time, see latency_tracker.h.
+    Histogram input_to_keypad_us;
+    Histogram input_to_read_us;
+    Histogram input_to_pixels_us;
+    Histogram input_to_photon_us;
+    Counter inputs_abandoned;
+    // Frames FrameCapture couldn't queue because its writer fell behind.
+    Counter capture_frames_dropped;
+    // How late SessionHost started each frame, relative to its deadline.
+    Histogram frame_lateness_us;
+    // Sessions SessionHost moved between threads to even out load.
+    Counter sessions_migrated;
+
+    std::string ToPrometheus() const;
+    std::string ToJson() const;
+
+  private:
+    struct Entry {
+      const char* name;
+      const char* help;
+      const Counter* counter;
+      const Histogram* histogram;
+    };
+    std::vector<Entry> registry_;
+};
+
+// Periodically writes the metrics to a file from a low-priority thread.
+// Files ending in .json get JSON, everything else Prometheus text format.
+// The file is replaced atomically so scrapers never see a partial dump.
+class MetricsDumper {
+  public:
+    MetricsDumper(const Metrics* metrics, const std::string& filename,
+      std::chrono::milliseconds interval = std::chrono::seconds(5));
+    // Writes a final dump and joins the thread.
+    ~MetricsDumper();
+
+  private:
+    void Dump();
+
+    const Metrics* metrics_;
+    const std::string filename_;
+    const std::chrono::milliseconds interval_;
+
+    std::mutex mu_; // protects stop_
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+#endif
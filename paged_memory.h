@@ -0,0 +1,128 @@
+#ifndef C8_PAGED_MEMORY_H_
+#define C8_PAGED_MEMORY_H_
+
+#include <atomic>
+
+#include "common.h"
+#include "hash.h"
+
+// kSize bytes of emulated memory in kNumPages reference-counted pages.
+// Copies share every page and a page is only copied by the first write to
+// it while shared, so copying costs kNumPages reference count increments
+// whatever kSize is. Addresses must already be masked to kSize.
+//
+// A copy can be handed to another thread; each copy must only be used by
+// one thread at a time.
+
+template <int kSize>
+class PagedMemory {
+  public:
+    static constexpr unsigned kNumPages = 16;
+    static constexpr unsigned kPageSize = kSize / kNumPages;
+
+    // All zero.
+    PagedMemory() {
+      for (Page*& page : pages_) page = new Page();
+    }
+    PagedMemory(const PagedMemory& other) :
+        fetch_page_(other.fetch_page_), fetch_bytes_(other.fetch_bytes_) {
+      for (unsigned p = 0; p < kNumPages; p++) {
+        pages_[p] = other.pages_[p];
+        pages_[p]->refs.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    PagedMemory& operator=(const PagedMemory& other) {
+      for (unsigned p = 0; p < kNumPages; p++) {
+        other.pages_[p]->refs.fetch_add(1, std::memory_order_relaxed);
+        Release(pages_[p]);
+        pages_[p] = other.pages_[p];
+      }
+      fetch_page_ = other.fetch_page_;
+      fetch_bytes_ = other.fetch_bytes_;
+      return *this;
+    }
+    ~PagedMemory() {
+      for (Page* page : pages_) Release(page);
+    }
+
+    uint8_t Read(unsigned addr) const { return pages_[addr / kPageSize]->bytes[addr % kPageSize]; }
+    // Big-endian word at addr, for instruction fetch. addr + 1 wraps at
+    // kSize. Remembers the page it read, so code running within one page
+    // doesn't wait on the page table before every fetch.
+    uint16_t Fetch(unsigned addr) {
+      unsigned offset = addr % kPageSize;
+      if (addr / kPageSize != fetch_page_) {
+        fetch_page_ = addr / kPageSize;
+        fetch_bytes_ = pages_[fetch_page_]->bytes;
+      }
+      if (offset + 1 < kPageSize) return fetch_bytes_[offset] << 8 | fetch_bytes_[offset + 1];
+      return fetch_bytes_[offset] << 8 | Read((addr + 1) % kSize);
+    }
+    void Write(unsigned addr, uint8_t value) {
+      Page* page = pages_[addr / kPageSize];
+      if (page->refs.load(std::memory_order_acquire) != 1) page = Unshare(addr / kPageSize);
+      page->bytes[addr % kPageSize] = value;
+      if (page->hash.load(std::memory_order_relaxed) != 0) {
+        page->hash.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    // The rest of addr's page, for reading runs of bytes without copying.
+    // Valid until the next write.
+    const uint8_t* Span(unsigned addr) const {
+      return &pages_[addr / kPageSize]->bytes[addr % kPageSize];
+    }
+    // Bytes from addr to the end of its page.
+    static int SpanLength(unsigned addr) { return kPageSize - addr % kPageSize; }
+
+    // Copies length bytes starting at addr, wrapping at kSize.
+    void CopyOut(unsigned addr, int length, uint8_t* out) const {
+      for (int i = 0; i < length; i++) out[i] = Read((addr + i) % kSize);
+    }
+
+    // Hash of the contents, combined from per-page HashWords(). Page hashes
+    // are kept until the page is written, so hashing memory that mostly
+    // didn't change since it was copied is cheap.
+    uint64_t Hash() const {
+      uint64_t hash = kHashSeed;
+      for (const Page* page : pages_) {
+        uint64_t page_hash = page->hash.load(std::memory_order_relaxed);
+        if (page_hash == 0) {
+          page_hash = HashWords(page->bytes, kPageSize) | 1;
+          page->hash.store(page_hash, std::memory_order_relaxed);
+        }
+        hash = HashBytes(&page_hash, sizeof(page_hash), hash);
+      }
+      return hash;
+    }
+
+  private:
+    struct Page {
+      std::atomic<int> refs{1};
+      // Cached HashWords() of bytes with the low bit set, 0 when stale.
+      // Filled lazily by whichever sharer hashes it first.
+      mutable std::atomic<uint64_t> hash{0};
+      uint8_t bytes[kPageSize] = {0};
+    };
+
+    static void Release(Page* page) {
+      if (page->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete page;
+    }
+
+    // Replaces shared page p with a private copy.
+    Page* Unshare(unsigned p) {
+      Page* copy = new Page();
+      std::memcpy(copy->bytes, pages_[p]->bytes, kPageSize);
+      Release(pages_[p]);
+      pages_[p] = copy;
+      if (p == fetch_page_) fetch_bytes_ = copy->bytes;
+      return copy;
+    }
+
+    Page* pages_[kNumPages];
+    // Page of the last Fetch() and its bytes, kNumPages before the first.
+    unsigned fetch_page_ = kNumPages;
+    const uint8_t* fetch_bytes_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "rom_database.h"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include "hash.h"
+
+uint64_t HashRomFile(const std::string& filename) {
+  std::ifstream input(filename, std::ios::in | std::ios::binary);
+  if (!input) throw std::runtime_error("Couldn't open ROM " + filename);
+  std::vector<uint8_t> bytes(
+         (std::istreambuf_iterator<char>(input)),
+         (std::istreambuf_iterator<char>()));
+  return HashBytes(bytes.data(), bytes.size());
+}
+
+bool FindRom(const std::string& database_filename, uint64_t rom_hash,
+    CpuChip8::Machine* machine, CpuChip8::QuirkSet* quirks) {
+  std::ifstream input(database_filename);
+  if (!input) throw std::runtime_error("Couldn't open ROM database " + database_filename);
+  std::string line;
+  for (int line_number = 1; std::getline(input, line); line_number++) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream tokens(line);
+    std::string hash_str;
+    if (!(tokens >> hash_str)) continue;
+
+    std::string where = database_filename + ":" + std::to_string(line_number);
+    uint64_t hash;
+    try {
+      hash = std::stoull(hash_str, nullptr, 16);
+    } catch (const std::exception&) {
+      throw std::runtime_error(where + ": bad ROM hash " + hash_str);
+    }
+    if (hash != rom_hash) continue;
+
+    std::string machine_name, quirks_name;
+    CpuChip8::Machine entry_machine;
+    CpuChip8::QuirkSet entry_quirks;
+    if (!(tokens >> machine_name >> quirks_name) ||
+        !CpuChip8::ParseMachine(machine_name, &entry_machine) ||
+        !CpuChip8::ParseQuirkSet(quirks_name, &entry_quirks)) {
+      throw std::runtime_error(where + ": expected <hash> <machine> <quirks>");
+    }
+    *machine = entry_machine;
+    *quirks = entry_quirks;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,25 @@
+#ifndef C8_ROM_DATABASE_H_
+#define C8_ROM_DATABASE_H_
+
+#include "common.h"
+#include "cpu_chip8.h"
+
+// Maps ROMs, by a hash of their bytes, to the machine and quirk set they
+// were written for. One entry per line, '#' starts a comment:
+//
+//   <hex rom hash> <machine|auto> <quirks|auto>
+//   8f3d2a1c09e4b7d5 chip8 cosmac   # Space Invaders
+//
+// The hash is HashRomFile() of the ROM, also printed when a verbose CPU
+// loads it.
+
+// Hash of the whole ROM file. Throws if it can't be read.
+uint64_t HashRomFile(const std::string& filename);
+
+// Looks rom_hash up in the database file. Returns false if there is no entry,
+// in which case machine and quirks are untouched. Throws on unreadable files
+// and malformed lines.
+bool FindRom(const std::string& database_filename, uint64_t rom_hash,
+  CpuChip8::Machine* machine, CpuChip8::QuirkSet* quirks);
+
+#endif
@@ -0,0 +1,39 @@
+#include "sdl_audio.h"
+
+#include <SDL2/SDL.h>
+
+#include "common.h"
+#include "sound.h"
+
+SDLAudio::SDLAudio(SoundRing* edges, int cycle_speed_hz, int tone_hz) :
+    edges_(edges), wave_(kSampleRate, tone_hz, cycle_speed_hz) {
+  if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+    throw std::runtime_error(SDL_GetError());
+  }
+  SDL_AudioSpec want;
+  std::memset(&want, 0, sizeof(want));
+  want.freq = kSampleRate;
+  want.format = AUDIO_S16SYS;
+  want.channels = 1;
+  // ~12ms of latency.
+  want.samples = 512;
+  want.callback = &SDLAudio::AudioCallback;
+  want.userdata = this;
+  device_ = SDL_OpenAudioDevice(nullptr, 0, &want, nullptr, 0);
+  if (device_ == 0) {
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    throw std::runtime_error(SDL_GetError());
+  }
+  SDL_PauseAudioDevice(device_, 0);
+}
+
+SDLAudio::~SDLAudio() {
+  SDL_CloseAudioDevice(device_);
+  SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
+
+void SDLAudio::AudioCallback(void* userdata, Uint8* stream, int len) {
+  SDLAudio* audio = static_cast<SDLAudio*>(userdata);
+  audio->wave_.Render(audio->edges_, reinterpret_cast<int16_t*>(stream),
+    len / sizeof(int16_t), /*realtime=*/true);
+}
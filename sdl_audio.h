@@ -0,0 +1,27 @@
+#ifndef SDL_AUDIO_H_
+#define SDL_AUDIO_H_
+
+#include <SDL2/SDL.h>
+
+#include "common.h"
+#include "sound.h"
+
+// RAII SDL audio device playing the CPU's sound edges as a square wave.
+// The edges are consumed on SDL's audio thread.
+
+class SDLAudio {
+  public:
+    SDLAudio(SoundRing* edges, int cycle_speed_hz, int tone_hz = 440);
+    ~SDLAudio();
+
+  private:
+    static void AudioCallback(void* userdata, Uint8* stream, int len);
+
+    static constexpr int kSampleRate = 44100;
+
+    SoundRing* edges_;
+    SquareWave wave_;
+    SDL_AudioDeviceID device_ = 0;
+};
+
+#endif
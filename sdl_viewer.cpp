@@ -1,13 +1,19 @@
 #include "sdl_viewer.h"
 
+#include <chrono>
 #include <mutex>
 #include <string>
 #include <SDL2/SDL.h>
 
 #include "common.h"
 
-SDLViewer::SDLViewer(const std::string& title, int width, int height, int window_scale) : 
-      title_(title) {
+SDLViewer::SDLViewer(const std::string& title, int width, int height, int window_scale,
+      Metrics* metrics, const Upscaler::Options* upscale) : title_(title), width_(width),
+      metrics_(metrics), staged_(width * height * 3), staged_frame_(width, height),
+      upscale_(upscale != nullptr), present_frame_(width, height) {
+  staged_frame_.SetAll(0);
+  if (upscale) upscale_options_ = *upscale;
+  int texture_scale = upscale_ ? upscale_options_.scale : 1;
   if(SDL_Init(SDL_INIT_VIDEO) < 0) {
     throw std::runtime_error(SDL_GetError());
   }
@@ -23,10 +29,14 @@ SDLViewer::SDLViewer(const std::string& title, int width, int height, int window
   SDL_SetRenderDrawColor(renderer_, 0xFF, 0xFF, 0xFF, 0xFF);
 
   window_tex_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGB24,
-    SDL_TEXTUREACCESS_STREAMING, width, height);
+    SDL_TEXTUREACCESS_STREAMING, width * texture_scale, height * texture_scale);
   if (!window_tex_) {
     throw std::runtime_error(SDL_GetError());
   }
+  frame_event_ = SDL_RegisterEvents(1);
+  if (frame_event_ == static_cast<uint32_t>(-1)) {
+    throw std::runtime_error("Out of SDL user events.");
+  }
 
   timer_.Start();
 }
@@ -39,39 +49,94 @@ SDLViewer::~SDLViewer() {
 }
 
 
-std::vector<SDL_Event> SDLViewer::Update() {
-  const std::lock_guard<std::mutex> lock(mu_);
+std::vector<SDL_Event> SDLViewer::WaitEvents(int timeout_ms) {
   std::vector<SDL_Event> events;
-  if (!window_tex_) {
-    throw std::runtime_error("Need to set the frame before calling Update().");
-  }
-
   SDL_Event e;
-  while (SDL_PollEvent(&e)) { events.push_back(e); }
+  if (!SDL_WaitEventTimeout(&e, timeout_ms)) return events;
+  do {
+    if (e.type == frame_event_) {
+      const std::lock_guard<std::mutex> lock(mu_);
+      wakeup_queued_ = false;
+    } else {
+      events.push_back(e);
+    }
+  } while (SDL_PollEvent(&e));
+  return events;
+}
 
+bool SDLViewer::Present() {
+  std::chrono::steady_clock::time_point start;
+  void* pixeldata;
+  int pitch;
+  {
+    const std::lock_guard<std::mutex> lock(mu_);
+    if (!frame_pending_) return false;
+    start = std::chrono::steady_clock::now();
+    if (upscale_) {
+      // Only the small frame is copied under the lock, the upscale below
+      // would hold up SetFrame() on the CPU thread.
+      std::memcpy(present_frame_.Row(0), staged_frame_.Row(0),
+        staged_frame_.Cols() * staged_frame_.Rows());
+    } else {
+      // Lock the texture and upload the image to the GPU.
+      SDL_LockTexture(window_tex_, nullptr, &pixeldata, &pitch);
+      for (int r = 0; r < staged_height_; r++) {
+        std::memcpy(static_cast<uint8_t*>(pixeldata) + r * pitch, &staged_[r * width_ * 3],
+          width_ * 3);
+      }
+      SDL_UnlockTexture(window_tex_);
+    }
+    frame_pending_ = false;
+  }
+  if (upscale_) {
+    SDL_LockTexture(window_tex_, nullptr, &pixeldata, &pitch);
+    upscaler_.Run(present_frame_, upscale_options_, static_cast<uint8_t*>(pixeldata), pitch);
+    SDL_UnlockTexture(window_tex_);
+  }
+  if (metrics_) {
+    metrics_->texture_upload_us.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count());
+  }
+  // Blocks until vsync, without holding up the next SetFrameRGB24() or
+  // SetFrame().
   SDL_RenderCopy(renderer_, window_tex_, NULL, NULL );
   SDL_RenderPresent(renderer_);
+  if (metrics_) metrics_->frames_presented.Add();
 
-  ++num_updates_;
+  ++num_presents_;
 
   // Compute fps and set window title.
-  float avg_fps = num_updates_ / (timer_.Ms() / 1000.0f);
-  SDL_SetWindowTitle(window_, 
-    (title_ + " - " + std::to_string(static_cast<int>(avg_fps)) + "fps").c_str());
-  if (timer_.Ms() >= 1'000) {
-    num_updates_ = 0;
+  uint32_t elapsed_ms = timer_.Ms();
+  if (elapsed_ms >= 1'000) {
+    float avg_fps = num_presents_ / (elapsed_ms / 1000.0f);
+    SDL_SetWindowTitle(window_,
+      (title_ + " - " + std::to_string(static_cast<int>(avg_fps)) + "fps").c_str());
+    num_presents_ = 0;
     timer_.Start();
   }
-
-  return events;
+  return true;
 }
 
 void SDLViewer::SetFrameRGB24(uint8_t* rgb24, int height) {
   const std::lock_guard<std::mutex> lock(mu_);
-  void* pixeldata;
-  int pitch;
-  // Lock the texture and upload the image to the GPU.
-  SDL_LockTexture(window_tex_, nullptr, &pixeldata, &pitch);
-  std::memcpy(pixeldata, rgb24, pitch * height);
-  SDL_UnlockTexture(window_tex_);
-}
\ No newline at end of file
+  std::memcpy(staged_.data(), rgb24, width_ * 3 * height);
+  staged_height_ = height;
+  Wake();
+}
+
+void SDLViewer::SetFrame(const Image& frame) {
+  const std::lock_guard<std::mutex> lock(mu_);
+  std::memcpy(staged_frame_.Row(0), frame.Row(0), frame.Cols() * frame.Rows());
+  Wake();
+}
+
+void SDLViewer::Wake() {
+  frame_pending_ = true;
+  // One wakeup in the queue at a time, the UI thread takes the latest frame.
+  if (!wakeup_queued_) {
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = frame_event_;
+    wakeup_queued_ = SDL_PushEvent(&e) == 1;
+  }
+}
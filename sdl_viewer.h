@@ -5,38 +5,75 @@
 #include <SDL2/SDL.h>
 
 #include "common.h"
+#include "image.h"
+#include "metrics.h"
 #include "sdl_timer.h"
+#include "upscale.h"
 
 // RAII hardware-accelerated SDL Window.
 // Optimized for RGB24 texture streaming.
-// This class is thread-safe.
-
-// TODO: Double buffer so we can SetFrame during Update ?
+// This class is thread-safe, but WaitEvents() and Present() must be called
+// from the thread that created it. Any thread can SetFrameRGB24(), it only
+// stages the frame and wakes the UI thread.
 
 class SDLViewer {
   public:
     // Width and height must be equal to the size of images uploaded
-    // via SetFrameRGB24.
-    SDLViewer(const std::string& title, int width, int height, int window_scale = 1);
+    // via SetFrameRGB24. Texture upload times go to metrics if provided.
+    // With upscale, frames come from SetFrame() instead and are upscaled on
+    // the CPU straight into a texture upscale->scale times the size, for
+    // filters the GPU doesn't have. The GPU still fits it to the window.
+    SDLViewer(const std::string& title, int width, int height, int window_scale = 1,
+      Metrics* metrics = nullptr, const Upscaler::Options* upscale = nullptr);
     ~SDLViewer();
 
-    // Renders the current frame, returns a list of all events.
-    std::vector<SDL_Event> Update();
+    // Blocks until there are events or a new frame, or timeout_ms passes.
+    // Returns all pending events, without the internal new-frame ones.
+    std::vector<SDL_Event> WaitEvents(int timeout_ms);
+
+    // Uploads and presents the staged frame if it's new since the last
+    // call, waiting for vsync. Returns whether it presented.
+    bool Present();
 
     // Assumes 8-bit RGB image with stride equal to width (no padding).
     void SetFrameRGB24(uint8_t* rgb24, int height);
+    // Stages the pixel values of a width x height frame, for upscaling.
+    void SetFrame(const Image& frame);
 
   private:
+    // Marks the staged frame new and queues a wakeup. Needs mu_.
+    void Wake();
+
     std::string title_;
+    int width_;
+    Metrics* metrics_;
+    // User event type pushed by SetFrameRGB24().
+    uint32_t frame_event_;
 
     std::mutex mu_; // protects the following
+    // The latest frame, waiting for Present().
+    std::vector<uint8_t> staged_;
+    int staged_height_ = 0;
+    bool frame_pending_ = false;
+    // Pixel values staged by SetFrame(), when upscaling.
+    Image staged_frame_;
+    // A frame event is queued and not yet seen by WaitEvents().
+    bool wakeup_queued_ = false;
+
+    // Only touched by the UI thread.
     SDL_Window* window_ = nullptr;
     SDL_Renderer* renderer_ = nullptr;
     SDL_Texture* window_tex_ = nullptr;
+    // Upscales on the UI thread, see the constructor.
+    bool upscale_ = false;
+    Upscaler::Options upscale_options_;
+    // staged_frame_ as of the last Present(), upscaled without mu_.
+    Image present_frame_;
+    Upscaler upscaler_;
 
-    // FPS counting.
-    uint32_t num_updates_ = 0;
+    // FPS counting, shown in the title once a second.
+    uint32_t num_presents_ = 0;
     SDLTimer timer_;
 };
 
-#endif
\ No newline at end of file
+#endif
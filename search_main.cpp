@@ -0,0 +1,118 @@
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "cpu_chip8.h"
+#include "image.h"
+#include "state_search.h"
+
+// Searches a ROM's input sequences for the one maximizing a memory byte,
+// e.g. a score counter, or the lit pixels. See state_search.h.
+// Usage: chip8_search --rom <file> [--machine m] [--quirks q] [--keys 456]
+//   [--warmup frames] [--frames-per-step n] [--depth n] [--max-states n]
+//   [--score-byte addr | --score-pixels] [--stop-score n] [-j threads]
+
+int main(int argc, char* args[]) {
+  CpuChip8::Options cpu_options;
+  cpu_options.verbose = false;
+  SearchOptions options;
+  int warmup_frames = 0;
+  int score_address = -1;
+  bool score_pixels = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = args[i];
+    bool ok = true;
+    if (arg == "--rom" && i + 1 < argc) {
+      cpu_options.rom_filename = args[++i];
+    } else if (arg == "--machine" && i + 1 < argc) {
+      ok = CpuChip8::ParseMachine(args[++i], &cpu_options.machine);
+    } else if (arg == "--quirks" && i + 1 < argc) {
+      ok = CpuChip8::ParseQuirkSet(args[++i], &cpu_options.quirks);
+    } else if (arg == "--keys" && i + 1 < argc) {
+      // No key, then each key alone.
+      options.inputs = {0};
+      for (char digit : std::string(args[++i])) {
+        int key = std::isxdigit(digit) ? std::stoi(std::string(1, digit), nullptr, 16) : -1;
+        ok &= key >= 0;
+        if (key >= 0) options.inputs.push_back(1 << key);
+      }
+    } else if (arg == "--warmup" && i + 1 < argc) {
+      warmup_frames = std::stoi(args[++i]);
+    } else if (arg == "--frames-per-step" && i + 1 < argc) {
+      options.frames_per_step = std::stoi(args[++i]);
+    } else if (arg == "--depth" && i + 1 < argc) {
+      options.max_depth = std::stoi(args[++i]);
+    } else if (arg == "--max-states" && i + 1 < argc) {
+      options.max_states = std::stoull(args[++i]);
+    } else if (arg == "--score-byte" && i + 1 < argc) {
+      score_address = std::stoi(args[++i], nullptr, 16);
+    } else if (arg == "--score-pixels") {
+      score_pixels = true;
+    } else if (arg == "--stop-score" && i + 1 < argc) {
+      options.stop_score = std::stod(args[++i]);
+    } else if (arg == "-j" && i + 1 < argc) {
+      options.threads = std::stoi(args[++i]);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::cerr << "Bad argument: " << args[i] << "\n";
+      return 2;
+    }
+  }
+  if (cpu_options.rom_filename.empty()) {
+    std::cerr << "Usage: " << args[0] << " --rom <file> [--machine m] [--quirks q] [--keys 456] "
+      "[--warmup frames] [--frames-per-step n] [--depth n] [--max-states n] "
+      "[--score-byte addr | --score-pixels] [--stop-score n] [-j threads]\n";
+    return 2;
+  }
+  if (score_address >= 0) {
+    options.score = [score_address](CpuChip8* cpu) {
+      uint8_t value;
+      cpu->ReadMemory(score_address, 1, &value);
+      return static_cast<double>(value);
+    };
+  } else if (score_pixels) {
+    options.score = [](CpuChip8* cpu) {
+      Image* frame = cpu->Frame();
+      int lit = 0;
+      for (int i = 0; i < frame->Cols() * frame->Rows(); i++) lit += frame->Row(0)[i] != 0;
+      return static_cast<double>(lit);
+    };
+  }
+
+  CpuChip8::ResolveOptions(&cpu_options);
+  std::unique_ptr<CpuChip8> cpu = CpuChip8::Create(cpu_options);
+  try {
+    cpu->Boot();
+  } catch (const std::exception& e) {
+    std::cerr << cpu_options.rom_filename << ": " << e.what() << "\n";
+    return 2;
+  }
+  for (int frame = 0; frame < warmup_frames; frame++) {
+    cpu->RunFrame();
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+  SearchResult result = SearchStates(*cpu, options);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+  std::cout << result.num_states << " states run, " << result.num_duplicates << " seen before, "
+    << static_cast<uint64_t>(result.num_states / std::max(seconds, 1e-9)) << " states/s.\n";
+  std::cout << "Best score " << result.best_score << " after " << result.best_inputs.size()
+    << " steps:";
+  for (uint16_t input : result.best_inputs) {
+    std::cout << " ";
+    if (input == 0) std::cout << "-";
+    for (int key = 0; key < 16; key++) {
+      if (input & (1 << key)) std::cout << "0123456789ABCDEF"[key];
+    }
+  }
+  std::cout << "\n";
+  return 0;
+}
@@ -0,0 +1,206 @@
+#include "session_host.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "common.h"
+
+constexpr int SessionHost::kWheelSlots;
+constexpr std::chrono::milliseconds SessionHost::kTick;
+constexpr int SessionHost::kRebalanceTicks;
+
+SessionHost::SessionHost(const Options& options) : options_(options), epoch_(Clock::now()),
+    frame_period_(std::chrono::duration_cast<Clock::duration>(
+      std::chrono::nanoseconds(1'000'000'000 / CpuChip8::kRefreshRateHz))) {
+  int num_threads = options_.num_threads;
+  if (num_threads <= 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < num_threads; i++) {
+    workers_.emplace_back(new Worker);
+  }
+  for (int i = 0; i < num_threads; i++) {
+    workers_[i]->thread = std::thread([this, i]() { WorkerLoop(i); });
+    #ifdef __linux__
+    if (options_.pin_threads) {
+      cpu_set_t cores;
+      CPU_ZERO(&cores);
+      CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &cores);
+      pthread_setaffinity_np(workers_[i]->thread.native_handle(), sizeof(cores), &cores);
+    }
+    #endif
+  }
+}
+
+SessionHost::~SessionHost() {
+  running_ = false;
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+uint64_t SessionHost::Add(const CpuChip8::Options& cpu_options, const uint8_t* rom, size_t size) {
+  std::unique_ptr<Session> session(new Session);
+  session->id = next_id_++;
+  session->cpu = CpuChip8::Create(cpu_options);
+  session->cpu->Boot(rom, size);
+  session->deadline = Clock::now();
+  uint64_t id = session->id;
+  {
+    const std::lock_guard<std::mutex> lock(sessions_mu_);
+    sessions_[id] = session.get();
+  }
+  auto least_loaded = std::min_element(workers_.begin(), workers_.end(),
+    [](const std::unique_ptr<Worker>& a, const std::unique_ptr<Worker>& b) {
+      return a->num_sessions.load() < b->num_sessions.load();
+    });
+  Send(least_loaded->get(), std::move(session));
+  return id;
+}
+
+void SessionHost::Remove(uint64_t id) {
+  const std::lock_guard<std::mutex> lock(sessions_mu_);
+  auto session = sessions_.find(id);
+  if (session != sessions_.end()) session->second->removed = true;
+}
+
+size_t SessionHost::NumSessions() {
+  const std::lock_guard<std::mutex> lock(sessions_mu_);
+  return sessions_.size();
+}
+
+void SessionHost::Send(Worker* worker, std::unique_ptr<Session> session) {
+  worker->num_sessions++;
+  const std::lock_guard<std::mutex> lock(worker->inbox_mu);
+  worker->inbox.push_back(std::move(session));
+}
+
+void SessionHost::Destroy(Worker* worker, std::unique_ptr<Session> session) {
+  worker->num_sessions--;
+  const std::lock_guard<std::mutex> lock(sessions_mu_);
+  sessions_.erase(session->id);
+}
+
+int64_t SessionHost::TickOf(Clock::time_point time) const {
+  return (time - epoch_) / kTick;
+}
+
+SessionHost::Clock::time_point SessionHost::TimeOf(int64_t tick) const {
+  return epoch_ + tick * kTick;
+}
+
+void SessionHost::Schedule(Worker* worker, std::unique_ptr<Session> session, int64_t min_tick) {
+  int64_t tick = std::max(TickOf(session->deadline), min_tick);
+  worker->wheel[tick % kWheelSlots].push_back(std::move(session));
+}
+
+void SessionHost::WorkerLoop(int index) {
+  Worker* worker = workers_[index].get();
+  worker->next_tick = TickOf(Clock::now());
+  int64_t period_start_tick = worker->next_tick;
+  Clock::duration busy = Clock::duration::zero();
+  std::vector<std::unique_ptr<Session>> arrivals;
+
+  while (running_.load()) {
+    auto wake_time = Clock::now();
+    {
+      const std::lock_guard<std::mutex> lock(worker->inbox_mu);
+      arrivals.swap(worker->inbox);
+    }
+    for (auto& session : arrivals) {
+      Schedule(worker, std::move(session), worker->next_tick);
+    }
+    arrivals.clear();
+
+    int64_t now_tick = TickOf(Clock::now());
+    // After a stall, one lap of the wheel visits every session.
+    worker->next_tick = std::max(worker->next_tick, now_tick - kWheelSlots + 1);
+    for (; worker->next_tick <= now_tick; worker->next_tick++) {
+      RunSlot(worker, worker->next_tick);
+    }
+    busy += Clock::now() - wake_time;
+
+    if (worker->next_tick - period_start_tick >= kRebalanceTicks) {
+      auto elapsed = (worker->next_tick - period_start_tick) * kTick;
+      worker->load_permille = static_cast<int>(busy * 1000 / elapsed);
+      Rebalance(index);
+      period_start_tick = worker->next_tick;
+      busy = Clock::duration::zero();
+    }
+    std::this_thread::sleep_until(TimeOf(worker->next_tick));
+  }
+}
+
+void SessionHost::RunSlot(Worker* worker, int64_t tick) {
+  std::vector<std::unique_ptr<Session>> due;
+  due.swap(worker->wheel[tick % kWheelSlots]);
+  for (auto& session : due) {
+    if (TickOf(session->deadline) > tick) {
+      // A lap early, only possible after a stall.
+      Schedule(worker, std::move(session), tick + 1);
+    } else if (RunSession(session.get())) {
+      Schedule(worker, std::move(session), tick + 1);
+    } else {
+      Destroy(worker, std::move(session));
+    }
+  }
+}
+
+bool SessionHost::RunSession(Session* session) {
+  if (session->removed.load()) return false;
+  auto now = Clock::now();
+  auto lateness = std::max(now - session->deadline, Clock::duration::zero());
+  Metrics* metrics = options_.metrics;
+  if (metrics) {
+    metrics->frame_lateness_us.Record(
+      std::chrono::duration_cast<std::chrono::microseconds>(lateness).count());
+    if (lateness > options_.miss_threshold) metrics->dropped_frames.Add();
+  }
+  try {
+    session->cpu->RunFrame();
+  } catch (const std::exception& e) {
+    if (options_.error_callback) options_.error_callback(session->id, e.what());
+    return false;
+  }
+  CpuChip8::FaultInfo fault = session->cpu->GetFault();
+  if (fault.fault != CpuChip8::Fault::kNone) {
+    if (options_.error_callback) {
+      options_.error_callback(session->id, CpuChip8::DescribeFault(fault));
+    }
+    return false;
+  }
+  session->deadline += frame_period_;
+  // Too far behind to catch up: skip the missed frames rather than burst.
+  if (session->deadline < now) session->deadline = now;
+  return true;
+}
+
+void SessionHost::Rebalance(int index) {
+  Worker* worker = workers_[index].get();
+  int load = worker->load_permille.load();
+  if (load <= options_.max_load * 1000 || workers_.size() < 2) return;
+  Worker* target = nullptr;
+  for (auto& other : workers_) {
+    if (other.get() == worker) continue;
+    if (!target || other->load_permille.load() < target->load_permille.load()) {
+      target = other.get();
+    }
+  }
+  // Move half the difference in load, assuming sessions cost about the same.
+  int target_load = target->load_permille.load();
+  if (target_load >= load) return;
+  size_t num_sessions = worker->num_sessions.load();
+  size_t to_move = num_sessions * (load - target_load) / (2 * load);
+  for (int slot = 0; slot < kWheelSlots && to_move > 0; slot++) {
+    auto& sessions = worker->wheel[slot];
+    while (!sessions.empty() && to_move > 0) {
+      worker->num_sessions--;
+      Send(target, std::move(sessions.back()));
+      sessions.pop_back();
+      to_move--;
+      if (options_.metrics) options_.metrics->sessions_migrated.Add();
+    }
+  }
+}
@@ -0,0 +1,117 @@
+#ifndef C8_SESSION_HOST_H_
+#define C8_SESSION_HOST_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "common.h"
+#include "cpu_chip8.h"
+#include "metrics.h"
+
+// Runs many CPU instances in real time on a few threads, instead of a
+// thread per CpuChip8 sleeping in EmulationLoop().
+//
+// Each session is a small state machine that a worker resumes at its next
+// frame deadline: it runs one RunFrame() (which polls the keypad callback and
+// publishes the frame) and goes back on the worker's timer wheel one frame
+// period later. Workers are pinned one per core. A worker that spends too
+// much of its time busy hands sessions to the least loaded worker.
+//
+// All public methods are thread-safe. Session callbacks run on the worker
+// thread that owns the session at the time.
+
+class SessionHost {
+  public:
+    struct Options {
+      // Worker threads, 0 for one per hardware thread.
+      int num_threads = 0;
+      // Pin worker i to core i. Linux only, ignored elsewhere.
+      bool pin_threads = true;
+      // Frames starting later than this after their deadline count as
+      // dropped.
+      std::chrono::microseconds miss_threshold = std::chrono::milliseconds(2);
+      // Busy fraction above which a worker sheds sessions.
+      double max_load = 0.75;
+      // Optional. Receives dropped frames, lateness and migrations. Pass the
+      // same pointer in the sessions' options to get their counters too.
+      Metrics* metrics = nullptr;
+      // Optional. Called when a session's CPU faults or a callback throws,
+      // with a description. The session is removed.
+      std::function<void(uint64_t id, const std::string& error)> error_callback = nullptr;
+    };
+
+    SessionHost(const Options& options);
+    // Stops the workers and destroys every session.
+    ~SessionHost();
+
+    // Creates and boots a CPU with size bytes of ROM, then schedules its
+    // first frame right away. Returns the session id. Throws if the CPU
+    // can't be created or booted.
+    uint64_t Add(const CpuChip8::Options& cpu_options, const uint8_t* rom, size_t size);
+    // The session is destroyed by its worker before its next frame.
+    void Remove(uint64_t id);
+
+    size_t NumSessions();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    // Timer wheel resolution and size. The wheel spans several frame
+    // periods, so a session is never more than one lap ahead.
+    static constexpr int kWheelSlots = 64;
+    static constexpr std::chrono::milliseconds kTick{1};
+    // How often workers measure their load and rebalance, in ticks.
+    static constexpr int kRebalanceTicks = 1000;
+
+    struct Session {
+      uint64_t id;
+      std::unique_ptr<CpuChip8> cpu;
+      Clock::time_point deadline;
+      std::atomic<bool> removed{false};
+    };
+
+    struct Worker {
+      std::thread thread;
+      // Sessions handed to this worker, scheduled on its next tick.
+      std::mutex inbox_mu;
+      std::vector<std::unique_ptr<Session>> inbox;
+      // Only touched by the worker thread.
+      std::vector<std::unique_ptr<Session>> wheel[kWheelSlots];
+      int64_t next_tick = 0;
+      std::atomic<size_t> num_sessions{0};
+      // Busy fraction over the last rebalance period, in thousandths.
+      std::atomic<int> load_permille{0};
+    };
+
+    void WorkerLoop(int index);
+    // Runs every due session in the wheel slot of tick.
+    void RunSlot(Worker* worker, int64_t tick);
+    // Returns false if the session is gone and should be destroyed.
+    bool RunSession(Session* session);
+    // Puts session on the wheel no earlier than min_tick.
+    void Schedule(Worker* worker, std::unique_ptr<Session> session, int64_t min_tick);
+    // Moves sessions to the least loaded worker if this one is overloaded.
+    void Rebalance(int index);
+    void Send(Worker* worker, std::unique_ptr<Session> session);
+    void Destroy(Worker* worker, std::unique_ptr<Session> session);
+
+    int64_t TickOf(Clock::time_point time) const;
+    Clock::time_point TimeOf(int64_t tick) const;
+
+    const Options options_;
+    const Clock::time_point epoch_;
+    const Clock::duration frame_period_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> running_{true};
+    std::atomic<uint64_t> next_id_{1};
+
+    std::mutex sessions_mu_;  // protects sessions_
+    // For Remove(), the owning worker holds the Session itself.
+    std::unordered_map<uint64_t, Session*> sessions_;
+};
+
+#endif
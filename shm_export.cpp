@@ -0,0 +1,215 @@
+#include "shm_export.h"
+
+#include <cerrno>
+#include <climits>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "common.h"
+
+constexpr uint32_t ShmSegment::kMagic;
+constexpr uint32_t ShmSegment::kVersion;
+constexpr size_t ShmSegment::kPixelsOffset;
+
+namespace {
+size_t SegmentSize(int cols, int rows) {
+  return ShmSegment::kPixelsOffset + 2 * cols * rows;
+}
+
+#ifndef _WIN32
+ShmSegment* Map(int fd, size_t size) {
+  void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) throw std::runtime_error("Couldn't map shared memory.");
+  return static_cast<ShmSegment*>(addr);
+}
+
+// Whether name is an export whose owner has exited. Anything else, including
+// a segment that isn't ours, is left alone.
+bool IsStale(const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(ShmSegment::kPixelsOffset)) {
+    close(fd);
+    return false;
+  }
+  void* addr = mmap(nullptr, ShmSegment::kPixelsOffset, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return false;
+  const ShmSegment* segment = static_cast<const ShmSegment*>(addr);
+  bool stale = segment->magic == ShmSegment::kMagic && segment->version == ShmSegment::kVersion &&
+    kill(segment->owner_pid, 0) != 0 && errno == ESRCH;
+  munmap(addr, ShmSegment::kPixelsOffset);
+  return stale;
+}
+#endif
+}
+
+#ifndef _WIN32
+
+ShmExport::ShmExport(const std::string& name, int cols, int rows)
+    : name_(name), size_(SegmentSize(cols, rows)) {
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    if (!IsStale(name)) throw std::runtime_error("Shared memory " + name + " is already in use.");
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  }
+  if (fd < 0) throw std::runtime_error("Couldn't create shared memory " + name);
+  if (ftruncate(fd, size_) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Couldn't size shared memory " + name);
+  }
+  segment_ = Map(fd, size_);
+  segment_->cols = cols;
+  segment_->rows = rows;
+  segment_->owner_pid = getpid();
+  segment_->generation.store(0);
+  segment_->waiters.store(0);
+  std::memset(segment_->slots, 0, sizeof(segment_->slots));
+  for (auto& key : segment_->keypad) key.store(0);
+  segment_->version = ShmSegment::kVersion;
+  // Readers check the magic last.
+  std::atomic_thread_fence(std::memory_order_release);
+  segment_->magic = ShmSegment::kMagic;
+}
+
+ShmExport::~ShmExport() {
+  munmap(segment_, size_);
+  shm_unlink(name_.c_str());
+}
+
+void ShmExport::Publish(const Image& frame, const CpuChip8::Registers& registers,
+    uint64_t num_cycles) {
+  // Only this thread changes the generation.
+  int back = (segment_->generation.load(std::memory_order_relaxed) + 1) & 1;
+  // Orders the writes below after the last publish, so a reader that sees
+  // any of them also sees the generation moved on from the slot's last one.
+  std::atomic_thread_fence(std::memory_order_release);
+  ShmSlot& slot = segment_->slots[back];
+  slot.frame_number = ++frame_number_;
+  slot.num_cycles = num_cycles;
+  slot.registers = registers;
+  std::memcpy(reinterpret_cast<uint8_t*>(segment_) + segment_->PixelsOffset(back), frame.Row(0),
+    segment_->cols * segment_->rows);
+  // Sequentially consistent with the waiters load below, so a reader either
+  // sees the new generation in its futex wait or is counted here.
+  segment_->generation.fetch_add(1);
+  if (segment_->waiters.load() > 0) {
+    #ifdef __linux__
+    syscall(SYS_futex, &segment_->generation, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    #endif
+  }
+}
+
+ShmReader::ShmReader(const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) throw std::runtime_error("No shared memory export named " + name);
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(ShmSegment::kPixelsOffset)) {
+    close(fd);
+    throw std::runtime_error("Shared memory " + name + " is too small.");
+  }
+  size_ = info.st_size;
+  segment_ = Map(fd, size_);
+  if (segment_->magic != ShmSegment::kMagic || segment_->version != ShmSegment::kVersion ||
+      SegmentSize(segment_->cols, segment_->rows) > size_) {
+    munmap(segment_, size_);
+    throw std::runtime_error("Shared memory " + name + " isn't a compatible export.");
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+ShmReader::~ShmReader() {
+  munmap(segment_, size_);
+}
+
+bool ShmReader::WaitForFrame(uint32_t generation, std::chrono::milliseconds timeout) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  segment_->waiters.fetch_add(1);
+  bool newer;
+  while (!(newer = segment_->generation.load() != generation) &&
+         std::chrono::steady_clock::now() < deadline) {
+    #ifdef __linux__
+    uint32_t seen = segment_->generation.load();
+    if (seen != generation) continue;
+    auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) break;
+    struct timespec wait_time;
+    wait_time.tv_sec = left.count() / 1'000'000'000;
+    wait_time.tv_nsec = left.count() % 1'000'000'000;
+    syscall(SYS_futex, &segment_->generation, FUTEX_WAIT, seen, &wait_time, nullptr, 0);
+    #else
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    #endif
+  }
+  segment_->waiters.fetch_sub(1);
+  return newer;
+}
+
+#else
+
+ShmExport::ShmExport(const std::string& name, int cols, int rows) {
+  throw std::runtime_error("Shared memory export needs POSIX shared memory.");
+}
+ShmExport::~ShmExport() {}
+void ShmExport::Publish(const Image& frame, const CpuChip8::Registers& registers,
+    uint64_t num_cycles) {}
+
+ShmReader::ShmReader(const std::string& name) {
+  throw std::runtime_error("Shared memory export needs POSIX shared memory.");
+}
+ShmReader::~ShmReader() {}
+bool ShmReader::WaitForFrame(uint32_t generation, std::chrono::milliseconds timeout) {
+  return false;
+}
+
+#endif
+
+void ShmExport::ReadKeypad(uint8_t* keypad) const {
+  for (int key = 0; key < 16; key++) {
+    keypad[key] |= segment_->keypad[key].load(std::memory_order_relaxed);
+  }
+}
+
+bool ShmReader::Read(CpuChip8::Registers* registers, uint8_t* pixels,
+    std::chrono::milliseconds timeout, uint32_t* generation, uint64_t* frame_number) const {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (true) {
+    uint32_t before = segment_->generation.load(std::memory_order_acquire);
+    int front = before & 1;
+    const ShmSlot& slot = segment_->slots[front];
+    if (registers) *registers = slot.registers;
+    if (pixels) {
+      std::memcpy(pixels, reinterpret_cast<const uint8_t*>(segment_) + segment_->PixelsOffset(front),
+        segment_->cols * segment_->rows);
+    }
+    if (frame_number) *frame_number = slot.frame_number;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // The CPU only writes this slot again after the next publish.
+    if (segment_->generation.load(std::memory_order_relaxed) == before) {
+      if (generation) *generation = before;
+      return true;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) return false;
+    std::this_thread::yield();
+  }
+}
+
+void ShmReader::SetKey(int key, bool down) {
+  segment_->keypad[key & 0xF].store(down, std::memory_order_relaxed);
+}
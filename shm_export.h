@@ -0,0 +1,116 @@
+#ifndef C8_SHM_EXPORT_H_
+#define C8_SHM_EXPORT_H_
+
+#include <atomic>
+#include <chrono>
+
+#include "common.h"
+#include "cpu_chip8.h"
+#include "image.h"
+
+// Exports a running CPU to other local processes through a POSIX
+// shared-memory segment: the frame, the registers and a keypad input channel.
+//
+// The segment holds two published frames, front and back. At the end of
+// each frame the CPU copies its frame and registers into the back one and
+// bumps the generation, which makes it the front: the front is generation
+// & 1. A reader copies the front and retries if the generation changed
+// meanwhile, so only a publish landing during the copy makes it retry. A
+// CPU paused mid-frame, e.g. at a debugger breakpoint, leaves the last
+// complete frame readable. ShmReader does this for you, giving up after a
+// timeout if publishes keep landing, or the segment was abandoned mid-copy.
+//
+// The segment records the exporting process, so a new export can replace a
+// segment left behind by a crash but not one another instance is using.
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Shared-memory atomics must be lock-free.");
+
+// One published frame. Its pixels are at ShmSegment::PixelsOffset().
+struct ShmSlot {
+  uint64_t frame_number;
+  uint64_t num_cycles;
+  CpuChip8::Registers registers;
+};
+
+// Layout of the segment. The two slots' pixels follow at kPixelsOffset.
+struct ShmSegment {
+  static constexpr uint32_t kMagic = 0x48533843;  // "C8SH"
+  static constexpr uint32_t kVersion = 3;
+  static constexpr size_t kPixelsOffset = 256;
+
+  uint32_t magic;
+  uint32_t version;
+  int32_t cols;
+  int32_t rows;
+  // Process that created the segment.
+  int32_t owner_pid;
+  // Frames published, the front slot is generation & 1. Also the futex
+  // word.
+  std::atomic<uint32_t> generation;
+  // Readers blocked in WaitForFrame(). The CPU only makes the wake syscall
+  // when this is non-zero.
+  std::atomic<uint32_t> waiters;
+  ShmSlot slots[2];
+  // Input channel, written by readers. Non-zero keys are held down, on top of
+  // whatever the host's keypad callback reports.
+  std::atomic<uint8_t> keypad[16];
+
+  // Offset of slot's pixels from the start of the segment.
+  size_t PixelsOffset(int slot) const { return kPixelsOffset + slot * cols * rows; }
+};
+
+static_assert(sizeof(ShmSegment) <= ShmSegment::kPixelsOffset, "ShmSegment overlaps the pixels.");
+
+// CPU side. Creates the segment on construction and unlinks it on
+// destruction. Used by CpuChip8Impl when Options::shm_name is set.
+class ShmExport {
+  public:
+    // name is a POSIX shm name such as "/chip8-0". Throws if the segment
+    // can't be created, or a live process already exports under name.
+    ShmExport(const std::string& name, int cols, int rows);
+    ~ShmExport();
+
+    // Publishes a finished frame, cols x rows, with its registers, and
+    // wakes blocked readers, if any.
+    void Publish(const Image& frame, const CpuChip8::Registers& registers, uint64_t num_cycles);
+
+    // ORs the keys held down by readers into keypad.
+    void ReadKeypad(uint8_t* keypad) const;
+
+  private:
+    std::string name_;
+    size_t size_;
+    ShmSegment* segment_;
+    uint64_t frame_number_ = 0;
+};
+
+// Consumer side, for sidecar processes. Maps an existing segment.
+class ShmReader {
+  public:
+    // Throws if the segment doesn't exist or isn't a compatible export.
+    ShmReader(const std::string& name);
+    ~ShmReader();
+
+    int Cols() const { return segment_->cols; }
+    int Rows() const { return segment_->rows; }
+
+    // Copies the latest published frame and its registers, either may be
+    // null. pixels must hold Cols() * Rows() bytes. Returns false if every
+    // copy within timeout overlapped a publish; the outputs then hold a torn
+    // copy. generation, if set, gets the generation read.
+    bool Read(CpuChip8::Registers* registers, uint8_t* pixels, std::chrono::milliseconds timeout,
+      uint32_t* generation = nullptr, uint64_t* frame_number = nullptr) const;
+
+    // Blocks until a frame newer than generation is published or timeout
+    // passes. Returns whether there is a newer frame.
+    bool WaitForFrame(uint32_t generation, std::chrono::milliseconds timeout);
+
+    // Holds or releases a key.
+    void SetKey(int key, bool down);
+
+  private:
+    size_t size_;
+    ShmSegment* segment_;
+};
+
+#endif
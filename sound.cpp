@@ -0,0 +1,29 @@
+#include "sound.h"
+
+#include "common.h"
+
+namespace {
+constexpr int16_t kAmplitude = 3000;
+}
+
+SquareWave::SquareWave(int sample_rate, int tone_hz, int cycle_speed_hz) :
+    cycles_per_sample_(static_cast<double>(cycle_speed_hz) / sample_rate),
+    phase_per_sample_(static_cast<double>(tone_hz) / sample_rate) {}
+
+void SquareWave::Render(SoundRing* edges, int16_t* samples, int count, bool realtime) {
+  for (int i = 0; i < count; i++) {
+    const SoundEdge* edge;
+    while ((edge = edges->Peek()) != nullptr) {
+      if (edge->cycle > cycle_) {
+        if (!realtime || on_ || !edge->on) break;
+        cycle_ = static_cast<double>(edge->cycle);
+      }
+      on_ = edge->on;
+      edges->Pop();
+    }
+    samples[i] = on_ ? (phase_ < 0.5 ? kAmplitude : -kAmplitude) : 0;
+    phase_ += phase_per_sample_;
+    if (phase_ >= 1.0) phase_ -= 1.0;
+    cycle_ += cycles_per_sample_;
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef C8_SOUND_H_
+#define C8_SOUND_H_
+
+#include "common.h"
+#include "spsc_ring.h"
+
+// The CPU reports the sound timer switching on or off, stamped with the
+// cycle it happened on. Consumers turn the edges into a square wave.
+struct SoundEdge {
+  uint64_t cycle;
+  bool on;
+};
+
+// Sized for many seconds of edges, the CPU drops edges rather than block.
+using SoundRing = SpscRing<SoundEdge, 1024>;
+
+// Renders the edge stream as a square wave of tone_hz at sample_rate.
+// Tracks the emulated cycle of the next sample.
+class SquareWave {
+  public:
+    SquareWave(int sample_rate, int tone_hz, int cycle_speed_hz);
+
+    // Fills samples, applying every edge up to the cycle of each sample.
+    // When realtime is set and the tone is off, a pending "on" edge starts
+    // playing immediately instead of waiting for the cycle clocks to meet,
+    // which keeps a drifting audio device in step with the CPU.
+    void Render(SoundRing* edges, int16_t* samples, int count, bool realtime);
+
+    double Cycle() const { return cycle_; }
+
+  private:
+    double cycles_per_sample_;
+    double phase_per_sample_;
+    double cycle_ = 0;
+    double phase_ = 0;
+    bool on_ = false;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef C8_SPSC_RING_H_
+#define C8_SPSC_RING_H_
+
+#include <atomic>
+
+#include "common.h"
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Capacity must be a power of two. Push() and Pop() never block and
+// never allocate.
+
+template <typename T, size_t kCapacity>
+class SpscRing {
+  public:
+    static_assert(kCapacity > 0 && (kCapacity & (kCapacity - 1)) == 0,
+      "Capacity must be a power of two.");
+
+    // Producer side. Returns false if the ring is full and the item was dropped.
+    bool Push(const T& item) {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - head_.load(std::memory_order_acquire) == kCapacity) {
+        return false;
+      }
+      items_[tail & (kCapacity - 1)] = item;
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer side. Returns nullptr if empty. The item stays valid until
+    // the next call to Pop().
+    const T* Peek() {
+      size_t head = head_.load(std::memory_order_relaxed);
+      if (head == tail_.load(std::memory_order_acquire)) {
+        return nullptr;
+      }
+      return &items_[head & (kCapacity - 1)];
+    }
+    void Pop() {
+      head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+  private:
+    // Head and tail on their own cache lines so the two threads don't
+    // fight over them.
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) T items_[kCapacity];
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include "state_search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include "common.h"
+#include "cpu_chip8.h"
+
+namespace {
+// Input sequences share their prefixes.
+struct Path {
+  std::shared_ptr<const Path> parent;
+  uint16_t input;
+};
+
+struct Node {
+  std::unique_ptr<CpuChip8> cpu;
+  std::shared_ptr<const Path> path;
+  int depth;
+  double score;
+};
+
+// Hashes of every state seen, sharded to keep the workers off each other.
+class VisitedSet {
+  public:
+    // Whether hash is new.
+    bool Insert(uint64_t hash) {
+      Shard& shard = shards_[hash >> (64 - kShardBits)];
+      const std::lock_guard<std::mutex> lock(shard.mu);
+      return shard.hashes.insert(hash).second;
+    }
+
+  private:
+    static constexpr int kShardBits = 6;
+    struct Shard {
+      std::mutex mu;
+      std::unordered_set<uint64_t> hashes;
+    };
+    Shard shards_[1 << kShardBits];
+};
+
+// One worker's states. The owner works at the back, thieves take from the
+// front.
+struct WorkQueue {
+  std::mutex mu;
+  std::deque<Node> nodes;
+};
+
+class Searcher {
+  public:
+    Searcher(const SearchOptions& options, unsigned num_workers) :
+        options_(options), queues_(num_workers) {}
+
+    void Run(Node start) {
+      visited_.Insert(start.cpu->StateHash());
+      best_score_ = start.score;
+      best_.best_state = start.cpu->Fork();
+      pending_ = 1;
+      queues_[0].nodes.push_back(std::move(start));
+      std::vector<std::thread> workers;
+      for (unsigned w = 0; w < queues_.size(); w++) {
+        workers.emplace_back([this, w]() { Work(w); });
+      }
+      for (auto& worker : workers) {
+        worker.join();
+      }
+    }
+
+    SearchResult TakeResult() {
+      for (const Path* path = best_path_.get(); path; path = path->parent.get()) {
+        best_.best_inputs.push_back(path->input);
+      }
+      std::reverse(best_.best_inputs.begin(), best_.best_inputs.end());
+      best_.best_score = best_score_.load();
+      // Workers count one each past max_states on the way out.
+      best_.num_states = std::min(num_states_.load(), options_.max_states);
+      best_.num_duplicates = num_duplicates_.load();
+      return std::move(best_);
+    }
+
+  private:
+    void Work(unsigned self) {
+      Node node;
+      while (!stop_.load(std::memory_order_relaxed)) {
+        if (!Take(self, &node)) {
+          // Nothing to steal, but a busy worker may still push children.
+          if (pending_.load() == 0) return;
+          std::this_thread::yield();
+          continue;
+        }
+        Expand(self, &node);
+        pending_--;
+      }
+    }
+
+    // Own newest state first, else another worker's oldest.
+    bool Take(unsigned self, Node* node) {
+      for (unsigned i = 0; i < queues_.size(); i++) {
+        WorkQueue& queue = queues_[(self + i) % queues_.size()];
+        const std::lock_guard<std::mutex> lock(queue.mu);
+        if (queue.nodes.empty()) continue;
+        if (i == 0) {
+          *node = std::move(queue.nodes.back());
+          queue.nodes.pop_back();
+        } else {
+          *node = std::move(queue.nodes.front());
+          queue.nodes.pop_front();
+        }
+        return true;
+      }
+      return false;
+    }
+
+    void Expand(unsigned self, Node* node) {
+      std::vector<Node> children;
+      for (uint16_t input : options_.inputs) {
+        if (num_states_++ >= options_.max_states) {
+          stop_ = true;
+          return;
+        }
+        Node child;
+        child.cpu = node->cpu->Fork();
+        child.cpu->SetKeypad(input);
+        for (int frame = 0; frame < options_.frames_per_step; frame++) {
+          child.cpu->RunFrame();
+        }
+        if (!visited_.Insert(child.cpu->StateHash())) {
+          num_duplicates_++;
+          continue;
+        }
+        child.path = std::make_shared<const Path>(Path{node->path, input});
+        child.depth = node->depth + 1;
+        child.score = options_.score ? options_.score(child.cpu.get()) : 0;
+        Offer(child);
+        if (child.score >= options_.stop_score) {
+          stop_ = true;
+          return;
+        }
+        if (child.depth < options_.max_depth && child.score >= options_.prune_score &&
+            child.cpu->GetFault().fault == CpuChip8::Fault::kNone) {
+          children.push_back(std::move(child));
+        }
+      }
+      // Best last, so it's expanded next.
+      std::sort(children.begin(), children.end(),
+        [](const Node& a, const Node& b) { return a.score < b.score; });
+      pending_ += children.size();
+      WorkQueue& queue = queues_[self];
+      const std::lock_guard<std::mutex> lock(queue.mu);
+      for (Node& child : children) {
+        queue.nodes.push_back(std::move(child));
+      }
+    }
+
+    // Keeps child if it's the best so far.
+    void Offer(const Node& child) {
+      if (child.score <= best_score_.load()) return;
+      const std::lock_guard<std::mutex> lock(best_mu_);
+      if (child.score <= best_score_.load()) return;
+      best_score_ = child.score;
+      best_.best_state = child.cpu->Fork();
+      best_path_ = child.path;
+    }
+
+    const SearchOptions& options_;
+    std::vector<WorkQueue> queues_;
+    VisitedSet visited_;
+    // States queued or being expanded. The search is over at 0.
+    std::atomic<uint64_t> pending_{0};
+    std::atomic<bool> stop_{false};
+    std::atomic<uint64_t> num_states_{0};
+    std::atomic<uint64_t> num_duplicates_{0};
+
+    // Read without the lock to turn down worse states quickly.
+    std::atomic<double> best_score_;
+    std::mutex best_mu_;  // protects the writes to best_score_ and everything below
+    SearchResult best_;
+    std::shared_ptr<const Path> best_path_;
+};
+}
+
+SearchResult SearchStates(const CpuChip8& start, const SearchOptions& options) {
+  unsigned num_workers = options.threads ? options.threads : std::thread::hardware_concurrency();
+  Searcher searcher(options, std::max(1u, num_workers));
+  Node node;
+  node.cpu = start.Fork();
+  node.depth = 0;
+  node.score = options.score ? options.score(node.cpu.get()) : 0;
+  searcher.Run(std::move(node));
+  return searcher.TakeResult();
+}
@@ -0,0 +1,56 @@
+#ifndef C8_STATE_SEARCH_H_
+#define C8_STATE_SEARCH_H_
+
+#include <functional>
+#include <limits>
+
+#include "common.h"
+#include "cpu_chip8.h"
+
+// Parallel search over input sequences, for automated testing and bots.
+//
+// From a start state, every step forks each state once per input in
+// SearchOptions::inputs, holds that keypad for frames_per_step frames and
+// scores the result. States seen before, by CpuChip8::StateHash(), are
+// dropped however they were reached. Each worker keeps a stack of states
+// and expands the best-scoring children first, so the search goes deep
+// early; an idle worker steals the oldest, shallowest state of another.
+// It ends when every state is expanded, after max_states states or when a
+// state scores stop_score.
+
+struct SearchOptions {
+  // Keypads to try at each step, bit k for key k. 0 presses nothing.
+  std::vector<uint16_t> inputs = {0};
+  int frames_per_step = 1;
+  // Longest input sequence.
+  int max_depth = 60;
+  // States to run before giving up.
+  uint64_t max_states = 100000;
+  // Stop as soon as a state scores this much.
+  double stop_score = std::numeric_limits<double>::infinity();
+  // 0 for one per core.
+  unsigned threads = 0;
+  // Scores a state from its frame, memory or registers, higher is better.
+  // Called on the worker threads, concurrently for different states.
+  // States scoring below prune_score aren't expanded. Null scores all 0,
+  // which explores breadth of distinct states.
+  std::function<double(CpuChip8* cpu)> score = nullptr;
+  double prune_score = -std::numeric_limits<double>::infinity();
+};
+
+struct SearchResult {
+  // The start state when no state scored higher.
+  double best_score = 0;
+  // Keypad per step from the start to the best state.
+  std::vector<uint16_t> best_inputs;
+  // A fork of the best state.
+  std::unique_ptr<CpuChip8> best_state;
+  // States run, and dropped as seen before.
+  uint64_t num_states = 0;
+  uint64_t num_duplicates = 0;
+};
+
+// start is only forked, it can't be running.
+SearchResult SearchStates(const CpuChip8& start, const SearchOptions& options);
+
+#endif
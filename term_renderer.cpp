@@ -0,0 +1,110 @@
+#include "term_renderer.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "common.h"
+#include "image.h"
+
+namespace {
+// Indexed by top pixel | bottom pixel << 1.
+const char* const kGlyphs[4] = {" ", "\xE2\x96\x80", "\xE2\x96\x84", "\xE2\x96\x88"};
+}
+
+TermRenderer::TermRenderer(int cols, int rows, int max_fps, int fd) :
+    cols_(cols), rows_(rows), fd_(fd),
+    min_interval_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::seconds(1)) / max_fps),
+    pending_(cols * rows), current_(cols * rows), presented_(cols * rows) {
+  thread_ = std::thread([this]() { RenderLoop(); });
+}
+
+TermRenderer::~TermRenderer() {
+  {
+    const std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  pending_cv_.notify_one();
+  thread_.join();
+  // Park the cursor under the frame and show it again.
+  Write("\x1b[" + std::to_string((rows_ + 1) / 2 + 1) + ";1H\x1b[?25h");
+}
+
+void TermRenderer::Submit(Image* frame) {
+  // Only the submitting thread touches last_submit_.
+  auto now = std::chrono::steady_clock::now();
+  if (now - last_submit_ < min_interval_) return;
+  std::unique_lock<std::mutex> lock(mu_, std::try_to_lock);
+  if (!lock.owns_lock()) return;
+  last_submit_ = now;
+  for (int r = 0; r < rows_; r++) {
+    std::memcpy(&pending_[r * cols_], frame->Row(r), cols_);
+  }
+  has_pending_ = true;
+  lock.unlock();
+  pending_cv_.notify_one();
+}
+
+void TermRenderer::RenderLoop() {
+  std::string out;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      pending_cv_.wait(lock, [this]() { return has_pending_ || stop_; });
+      if (stop_) return;
+      current_.swap(pending_);
+      has_pending_ = false;
+    }
+    out.clear();
+    if (!presented_valid_) {
+      // Clear the screen and hide the cursor before the first frame.
+      out += "\x1b[2J\x1b[?25l";
+    }
+    Diff(&out);
+    if (!out.empty()) Write(out);
+    presented_.swap(current_);
+    presented_valid_ = true;
+  }
+}
+
+void TermRenderer::Diff(std::string* out) {
+  // Where the terminal cursor is, -1 when unknown.
+  int cursor_x = -1;
+  int cursor_y = -1;
+  for (int cell_y = 0; cell_y < (rows_ + 1) / 2; cell_y++) {
+    int top = 2 * cell_y * cols_;
+    int bottom = top + cols_;
+    bool has_bottom = 2 * cell_y + 1 < rows_;
+    for (int x = 0; x < cols_; x++) {
+      int glyph = (current_[top + x] != 0) | (has_bottom && current_[bottom + x] != 0) << 1;
+      int old_glyph = (presented_[top + x] != 0) | (has_bottom && presented_[bottom + x] != 0) << 1;
+      if (presented_valid_ && glyph == old_glyph) continue;
+      if (cursor_x != x || cursor_y != cell_y) {
+        *out += "\x1b[" + std::to_string(cell_y + 1) + ";" + std::to_string(x + 1) + "H";
+      }
+      *out += kGlyphs[glyph];
+      cursor_x = x + 1;
+      cursor_y = cell_y;
+    }
+  }
+}
+
+void TermRenderer::Write(const std::string& out) {
+  size_t written = 0;
+  while (written < out.size()) {
+    #ifdef _WIN32
+    int n = _write(fd_, out.data() + written, static_cast<unsigned>(out.size() - written));
+    #else
+    ssize_t n = write(fd_, out.data() + written, out.size() - written);
+    #endif
+    if (n <= 0) return;
+    written += n;
+  }
+}
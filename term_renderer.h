@@ -0,0 +1,57 @@
+#ifndef C8_TERM_RENDERER_H_
+#define C8_TERM_RENDERER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "common.h"
+#include "image.h"
+
+// Draws frames to an ANSI terminal, for watching headless instances over
+// SSH. Each character cell shows two pixel rows using half-block glyphs and
+// only cells that changed since the last presented frame are re-emitted.
+// Each frame is a single write() of a buffered string.
+// Submit() is safe to call from the CPU thread, rendering happens on a
+// background thread.
+
+class TermRenderer {
+  public:
+    // Frames are dropped to stay at or below max_fps.
+    TermRenderer(int cols, int rows, int max_fps = 30, int fd = 1);
+    // Restores the cursor below the frame.
+    ~TermRenderer();
+
+    // Copies the frame if one is due and the render thread isn't busy
+    // swapping buffers. Never blocks.
+    void Submit(Image* frame);
+
+  private:
+    void RenderLoop();
+    // Appends the escapes turning presented_ into current_ to out.
+    void Diff(std::string* out);
+    void Write(const std::string& out);
+
+    const int cols_;
+    const int rows_;
+    const int fd_;
+    const std::chrono::steady_clock::duration min_interval_;
+    std::chrono::steady_clock::time_point last_submit_;
+
+    std::mutex mu_; // protects the following
+    std::condition_variable pending_cv_;
+    std::vector<uint8_t> pending_;
+    bool has_pending_ = false;
+    bool stop_ = false;
+
+    // Owned by the render thread.
+    std::vector<uint8_t> current_;
+    std::vector<uint8_t> presented_;
+    bool presented_valid_ = false;
+
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "upscale.h"
+
+#include <algorithm>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define C8_UPSCALE_SSE2
+#endif
+
+#include "common.h"
+#include "image.h"
+
+namespace {
+// Bands smaller than this aren't worth waking a worker for.
+constexpr int kMinBandRows = 64;
+
+// Pixel value of frame at c,r with the coordinates clamped to the edges.
+uint8_t ClampedAt(const Image& frame, int c, int r) {
+  c = std::min(std::max(c, 0), frame.Cols() - 1);
+  r = std::min(std::max(r, 0), frame.Rows() - 1);
+  return frame.Row(r)[c] & 0x3;
+}
+
+// Row sub_row of frame row r after Scale2x (factor 2) or Scale3x (3) into
+// out, frame.Cols() * factor values. Factor 1 copies the row.
+void SmoothRow(const Image& frame, int factor, int r, int sub_row, uint8_t* out) {
+  for (int c = 0; c < frame.Cols(); c++) {
+    uint8_t a = ClampedAt(frame, c - 1, r - 1);
+    uint8_t b = ClampedAt(frame, c, r - 1);
+    uint8_t cc = ClampedAt(frame, c + 1, r - 1);
+    uint8_t d = ClampedAt(frame, c - 1, r);
+    uint8_t e = ClampedAt(frame, c, r);
+    uint8_t f = ClampedAt(frame, c + 1, r);
+    uint8_t g = ClampedAt(frame, c - 1, r + 1);
+    uint8_t h = ClampedAt(frame, c, r + 1);
+    uint8_t i = ClampedAt(frame, c + 1, r + 1);
+    uint8_t* o = out + c * factor;
+    if (factor == 1) {
+      o[0] = e;
+    } else if (factor == 2) {
+      if (sub_row == 0) {
+        o[0] = d == b && b != f && d != h ? d : e;
+        o[1] = b == f && b != d && f != h ? f : e;
+      } else {
+        o[0] = d == h && d != b && h != f ? d : e;
+        o[1] = h == f && d != h && b != f ? f : e;
+      }
+    } else if (sub_row == 0) {
+      o[0] = d == b && b != f && d != h ? d : e;
+      o[1] = (d == b && b != f && d != h && e != cc) || (b == f && b != d && f != h && e != a) ?
+        b : e;
+      o[2] = b == f && b != d && f != h ? f : e;
+    } else if (sub_row == 1) {
+      o[0] = (d == b && b != f && d != h && e != g) || (d == h && d != f && b != d && e != a) ?
+        d : e;
+      o[1] = e;
+      o[2] = (b == f && b != d && f != h && e != i) || (h == f && d != h && b != f && e != cc) ?
+        f : e;
+    } else {
+      o[0] = d == h && d != f && b != d ? d : e;
+      o[1] = (d == h && d != f && b != d && e != i) || (h == f && d != h && b != f && e != g) ?
+        h : e;
+      o[2] = h == f && d != h && b != f ? f : e;
+    }
+  }
+}
+}
+
+bool Upscaler::ParseFilter(const std::string& name, Filter* filter) {
+  if (name == "nearest") {
+    *filter = Filter::kNearest;
+  } else if (name == "scale2x") {
+    *filter = Filter::kScale2x;
+  } else if (name == "scale3x") {
+    *filter = Filter::kScale3x;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int Upscaler::Factor(Filter filter) {
+  switch (filter) {
+    case Filter::kNearest: return 1;
+    case Filter::kScale2x: return 2;
+    case Filter::kScale3x: return 3;
+  }
+  return 1;
+}
+
+void Upscaler::Validate(const Options& options) {
+  int factor = Factor(options.filter);
+  if (options.scale < 1 || options.scale % factor != 0) {
+    throw std::runtime_error("Upscaling by " + std::to_string(options.scale) +
+      " needs a multiple of " + std::to_string(factor) + " for this filter.");
+  }
+  if (!options.palette) throw std::runtime_error("Upscaling needs a palette.");
+}
+
+Upscaler::Upscaler(int num_threads) {
+  for (int band = 1; band <= num_threads; band++) {
+    workers_.emplace_back([this, band]() { WorkerLoop(band); });
+  }
+}
+
+Upscaler::~Upscaler() {
+  {
+    const std::lock_guard<std::mutex> lock(mu_);
+    quit_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void Upscaler::Run(const Image& frame, const Options& options, uint8_t* dst, int pitch) {
+  Validate(options);
+  int factor = Factor(options.filter);
+  frame_ = &frame;
+  options_ = options;
+  dst_ = dst;
+  pitch_ = pitch;
+  run_ = options.scale / factor;
+  pattern_stride_ = (run_ * 3 + 15) / 16 * 16;
+
+  int grid_cols = options.grid_level < 256 ? std::max(1, options.scale / 8) : 0;
+  patterns_.assign(2 * 4 * factor * pattern_stride_, 0);
+  for (int dim = 0; dim < 2; dim++) {
+    for (int color = 0; color < 4; color++) {
+      for (int position = 0; position < factor; position++) {
+        uint8_t* pattern = &patterns_[((dim * 4 + color) * factor + position) * pattern_stride_];
+        for (int i = 0; i < run_; i++) {
+          int level = dim ? options.scanline_level : 256;
+          if (position * run_ + i >= options.scale - grid_cols) {
+            level = level * options.grid_level / 256;
+          }
+          for (int channel = 0; channel < 3; channel++) {
+            pattern[i * 3 + channel] = options.palette[color][channel] * level / 256;
+          }
+        }
+      }
+    }
+  }
+
+  int rows = frame.Rows() * options.scale;
+  int num_bands = std::min<int>(workers_.size() + 1, std::max(1, rows / kMinBandRows));
+  if (num_bands > 1) {
+    {
+      const std::lock_guard<std::mutex> lock(mu_);
+      num_bands_ = num_bands;
+      bands_left_ = num_bands - 1;
+      generation_++;
+    }
+    work_cv_.notify_all();
+  }
+  RunBand(0, rows / num_bands);
+  if (num_bands > 1) {
+    std::unique_lock<std::mutex> lock(mu_);
+    done_cv_.wait(lock, [this]() { return bands_left_ == 0; });
+  }
+}
+
+void Upscaler::WorkerLoop(int band) {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    work_cv_.wait(lock, [this, seen]() { return quit_ || generation_ != seen; });
+    if (quit_) return;
+    seen = generation_;
+    int num_bands = num_bands_;
+    if (band >= num_bands) continue;
+    lock.unlock();
+    int rows = frame_->Rows() * options_.scale;
+    RunBand(rows * band / num_bands, rows * (band + 1) / num_bands);
+    lock.lock();
+    if (--bands_left_ == 0) done_cv_.notify_one();
+  }
+}
+
+void Upscaler::RunBand(int begin, int end) {
+  const Image& frame = *frame_;
+  int scale = options_.scale;
+  int factor = scale / run_;
+  int num_smoothed = frame.Cols() * factor;
+  int row_bytes = frame.Cols() * scale * 3;
+  int run_bytes = run_ * 3;
+  int scanline_rows = options_.scanline_level < 256 ? std::max(1, scale / 4) : 0;
+  std::vector<uint8_t> smoothed(num_smoothed);
+  // Which smoothed row is in smoothed, and which output row the last
+  // written row is, as (frame row * factor + sub row) * 2 + dimmed.
+  int smoothed_key = -1;
+  int written_key = -1;
+  for (int y = begin; y < end; y++) {
+    int r = y / scale;
+    int offset = y % scale;
+    int sub_row = offset / run_;
+    bool dim = offset >= scale - scanline_rows;
+    int key = (r * factor + sub_row) * 2 + dim;
+    uint8_t* out = dst_ + static_cast<size_t>(y) * pitch_;
+    if (key == written_key) {
+      std::memcpy(out, out - pitch_, row_bytes);
+      continue;
+    }
+    if (key / 2 != smoothed_key) {
+      SmoothRow(frame, factor, r, sub_row, smoothed.data());
+      smoothed_key = key / 2;
+    }
+    const uint8_t* patterns = &patterns_[dim * 4 * factor * pattern_stride_];
+    const uint8_t* row_end = out + row_bytes;
+    for (int x = 0; x < num_smoothed; x++) {
+      const uint8_t* pattern = patterns + (smoothed[x] * factor + x % factor) * pattern_stride_;
+      #ifdef C8_UPSCALE_SSE2
+      // Whole blocks run up to 15 bytes into the next pixels' runs, which
+      // then overwrite them. Runs near the end of the row are copied exactly.
+      if (row_end - out >= pattern_stride_) {
+        for (int i = 0; i < run_bytes; i += 16) {
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + i)));
+        }
+      } else {
+        std::memcpy(out, pattern, run_bytes);
+      }
+      #else
+      std::memcpy(out, pattern, run_bytes);
+      #endif
+      out += run_bytes;
+    }
+    written_key = key;
+  }
+}
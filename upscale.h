@@ -0,0 +1,98 @@
+#ifndef C8_UPSCALE_H_
+#define C8_UPSCALE_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "image.h"
+
+// Upscales frames to RGB24 on the CPU, for captures without a GPU and for
+// filters the SDL renderer doesn't have. Writes straight into the caller's
+// buffer, e.g. a locked texture, with no intermediate frame: every distinct
+// output row is built once from per-color runs of pixels, 16 bytes at a
+// time with SSE2 where available, and repeated rows are copied from the
+// row above. Large outputs are split into bands of rows over a pool of
+// worker threads.
+//
+// Not thread-safe, one Run() at a time.
+
+class Upscaler {
+  public:
+    enum class Filter {
+      // Every frame pixel becomes a scale x scale square.
+      kNearest,
+      // Scale2x/Scale3x (AdvMAME) edge smoothing of the frame's pixel
+      // values, then nearest up to scale.
+      kScale2x,
+      kScale3x,
+    };
+
+    struct Options {
+      Filter filter = Filter::kNearest;
+      // Output pixels per frame pixel on each axis. Must be a multiple of 2
+      // for kScale2x and of 3 for kScale3x.
+      int scale = 10;
+      // Maps pixel values (plane bitmasks, 0-3) to RGB, like
+      // Image::CopyToRGB24(). Required.
+      const uint8_t (*palette)[3] = nullptr;
+      // Scanlines: the bottom quarter of every frame pixel row is dimmed to
+      // this many 256ths of its brightness. 256 for none.
+      int scanline_level = 256;
+      // Pixel grid: the right eighth of every frame pixel column is dimmed
+      // the same way. 256 for none.
+      int grid_level = 256;
+    };
+
+    // Parses "nearest", "scale2x" or "scale3x".
+    static bool ParseFilter(const std::string& name, Filter* filter);
+    // What the filter multiplies the frame by before nearest scaling: 1, 2
+    // or 3. Scales must be multiples of it.
+    static int Factor(Filter filter);
+    // Throws if Run() would.
+    static void Validate(const Options& options);
+
+    // Splits output over num_threads workers and the calling thread. 0
+    // runs everything on the calling thread.
+    Upscaler(int num_threads = 0);
+    ~Upscaler();
+
+    // Writes frame scaled by options.scale into dst: frame.Rows() * scale
+    // rows of frame.Cols() * scale RGB24 pixels, pitch bytes apart. Throws
+    // if the scale doesn't suit the filter or there's no palette.
+    void Run(const Image& frame, const Options& options, uint8_t* dst, int pitch);
+
+  private:
+    // Writes output rows [begin, end) of the current Run().
+    void RunBand(int begin, int end);
+    void WorkerLoop(int band);
+
+    // The current Run(), read by the workers.
+    const Image* frame_ = nullptr;
+    Options options_;
+    uint8_t* dst_ = nullptr;
+    int pitch_ = 0;
+    // Output pixels per smoothed pixel: scale / (1, 2 or 3).
+    int run_ = 0;
+    // Bytes between the runs in patterns_, a multiple of 16 so SSE2 can
+    // copy whole 16-byte blocks without reading past the end.
+    int pattern_stride_ = 0;
+    // Per brightness (normal, scanline), color and position in the frame
+    // pixel: the run_ RGB24 pixels it expands to, grid included.
+    std::vector<uint8_t> patterns_;
+
+    std::vector<std::thread> workers_;
+    std::mutex mu_;  // protects the fields below
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    // Bumped by Run() to start the workers on a frame.
+    uint64_t generation_ = 0;
+    // Bands of the current Run(), band 0 is the caller's.
+    int num_bands_ = 1;
+    int bands_left_ = 0;
+    bool quit_ = false;
+};
+
+#endif
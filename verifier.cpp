@@ -0,0 +1,235 @@
+#include "verifier.h"
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <sstream>
+
+#include "common.h"
+#include "cpu_chip8.h"
+#include "disassembler.h"
+#include "hash.h"
+#include "image.h"
+
+namespace {
+struct Executed {
+  uint64_t cycle;
+  uint16_t pc;
+  uint16_t opcode;
+};
+
+std::unique_ptr<CpuChip8> CreateEngine(const VerifyOptions& options, CpuChip8::Engine engine) {
+  CpuChip8::Options cpu_options;
+  cpu_options.machine = options.machine;
+  cpu_options.quirks = options.quirks;
+  cpu_options.engine = engine;
+  cpu_options.random_seed = options.seed;
+  cpu_options.verbose = false;
+  return CpuChip8::Create(cpu_options);
+}
+
+uint16_t OpcodeAt(CpuChip8* cpu, int address) {
+  uint8_t bytes[2];
+  cpu->ReadMemory(address, 2, bytes);
+  return bytes[0] << 8 | bytes[1];
+}
+
+std::vector<uint8_t> AllMemory(CpuChip8* cpu) {
+  std::vector<uint8_t> memory(cpu->MemorySize());
+  cpu->ReadMemory(0, cpu->MemorySize(), memory.data());
+  return memory;
+}
+
+// Returns whether they differ.
+bool DiffField(std::ostream& out, const char* name, int reference, int candidate) {
+  char line[64];
+  std::snprintf(line, sizeof(line), "  %-6s %04X  %04X%s\n", name, reference, candidate,
+    reference == candidate ? "" : "  <--");
+  out << line;
+  return reference != candidate;
+}
+
+std::string DiffState(CpuChip8* reference, CpuChip8* candidate) {
+  std::ostringstream out;
+  bool differs = false;
+  CpuChip8::Registers ref = reference->GetRegisters();
+  CpuChip8::Registers cand = candidate->GetRegisters();
+  out << "         ref   cand\n";
+  for (int v = 0; v < 16; v++) {
+    std::string name = "V" + std::string(1, "0123456789ABCDEF"[v]);
+    differs |= DiffField(out, name.c_str(), ref.v[v], cand.v[v]);
+  }
+  differs |= DiffField(out, "I", ref.index, cand.index);
+  differs |= DiffField(out, "PC", ref.pc, cand.pc);
+  differs |= DiffField(out, "SP", ref.sp, cand.sp);
+  for (int s = 0; s < std::max(ref.sp, cand.sp) && s < 16; s++) {
+    differs |= DiffField(out, ("S" + std::to_string(s)).c_str(), ref.stack[s], cand.stack[s]);
+  }
+  differs |= DiffField(out, "DT", ref.delay_timer, cand.delay_timer);
+  differs |= DiffField(out, "ST", ref.sound_timer, cand.sound_timer);
+  CpuChip8::FaultInfo ref_fault = reference->GetFault();
+  CpuChip8::FaultInfo cand_fault = candidate->GetFault();
+  if (ref_fault.fault != cand_fault.fault) {
+    differs = true;
+    out << "  fault  " << CpuChip8::DescribeFault(ref_fault) << " / "
+        << CpuChip8::DescribeFault(cand_fault) << "  <--\n";
+  }
+
+  Image* ref_frame = reference->Frame();
+  Image* cand_frame = candidate->Frame();
+  int differing = 0;
+  int first = -1;
+  int num_pixels = ref_frame->Cols() * ref_frame->Rows();
+  for (int i = 0; i < num_pixels; i++) {
+    if (ref_frame->Row(0)[i] == cand_frame->Row(0)[i]) continue;
+    if (first < 0) first = i;
+    differing++;
+  }
+  differs |= differing > 0;
+  if (differing > 0) {
+    out << "  frame: " << differing << " pixels differ, first at (" << first % ref_frame->Cols()
+        << ", " << first / ref_frame->Cols() << ")\n";
+  }
+  differing = 0;
+  first = -1;
+  std::vector<uint8_t> ref_memory = AllMemory(reference);
+  std::vector<uint8_t> cand_memory = AllMemory(candidate);
+  for (size_t i = 0; i < ref_memory.size(); i++) {
+    if (ref_memory[i] == cand_memory[i]) continue;
+    if (first < 0) first = i;
+    differing++;
+  }
+  differs |= differing > 0;
+  if (differing > 0) {
+    char line[96];
+    std::snprintf(line, sizeof(line), "  memory: %d bytes differ, first at 0x%03X (%02X / %02X)\n",
+      differing, first, ref_memory[first], cand_memory[first]);
+    out << line;
+  }
+  if (!differs) {
+    out << "  state outside the registers, frame and memory differs: display mode, planes,\n"
+           "  RND, a pending FX0A key or XO-CHIP audio\n";
+  }
+  return out.str();
+}
+
+std::string Report(CpuChip8* reference, CpuChip8* candidate, const std::deque<Executed>& history) {
+  std::ostringstream out;
+  out << "diverged after cycle " << reference->NumCycles() << " (frame "
+      << reference->NumCycles() / CpuChip8::kCyclesPerFrame << ")\n";
+  out << "last " << history.size() << " instructions:\n";
+  for (const Executed& executed : history) {
+    char line[48];
+    std::snprintf(line, sizeof(line), "  %8llu  %03X: %04X  ",
+      static_cast<unsigned long long>(executed.cycle), executed.pc, executed.opcode);
+    out << line << Disassemble(executed.opcode) << "\n";
+  }
+  out << DiffState(reference, candidate);
+  return out.str();
+}
+}
+
+VerifyResult VerifyLockstep(const uint8_t* rom, size_t size, const VerifyOptions& options) {
+  std::unique_ptr<CpuChip8> reference = CreateEngine(options, options.reference);
+  std::unique_ptr<CpuChip8> candidate = CreateEngine(options, options.candidate);
+  reference->Boot(rom, size);
+  candidate->Boot(rom, size);
+
+  // Input changes every few frames: a key goes down or comes up.
+  std::minstd_rand input(options.seed);
+  uint16_t keys = 0;
+  std::deque<Executed> history;
+  VerifyResult result;
+  result.trace_hash = kHashSeed;
+  int block = std::max(1, options.block);
+
+  for (int frame = 0; frame < options.frames; frame++) {
+    if (input() % 8 == 0) keys ^= 1 << (input() % 16);
+    reference->SetKeypad(keys);
+    candidate->SetKeypad(keys);
+    for (int cycle = 0; cycle < CpuChip8::kCyclesPerFrame; cycle += block) {
+      int n = std::min(block, CpuChip8::kCyclesPerFrame - cycle);
+      // The reference runs one instruction at a time to record them.
+      for (int i = 0; i < n; i++) {
+        uint16_t pc = reference->GetRegisters().pc;
+        history.push_back(Executed{reference->NumCycles(), pc, OpcodeAt(reference.get(), pc)});
+        if (static_cast<int>(history.size()) > options.history) history.pop_front();
+        reference->RunCycles(1);
+      }
+      candidate->RunCycles(n);
+      result.cycles = reference->NumCycles();
+
+      // Covers memory too, from cached per-page hashes, so a bad store is
+      // caught at the block that made it.
+      uint64_t hash = reference->StateHash();
+      if (hash != candidate->StateHash()) {
+        result.diverged = true;
+        result.report = Report(reference.get(), candidate.get(), history);
+        return result;
+      }
+      result.trace_hash = HashBytes(&hash, sizeof(hash), result.trace_hash);
+    }
+    // Both are spinning on the same fault, nothing more to compare.
+    result.fault = reference->GetFault().fault;
+    if (result.fault != CpuChip8::Fault::kNone) break;
+  }
+
+  return result;
+}
+
+std::vector<uint8_t> FuzzRom(uint32_t seed, size_t size, CpuChip8::Machine machine) {
+  bool schip = machine != CpuChip8::Machine::kChip8;
+  bool xochip = machine == CpuChip8::Machine::kXoChip;
+  // Low bytes and nibbles of the valid opcodes, extensions last.
+  static const uint8_t kSystem[] = {0xE0, 0xEE, 0xC4, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF, 0xD4};
+  static const uint8_t kMisc[] = {0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29, 0x33, 0x55, 0x65,
+    0x30, 0x75, 0x85, 0x01, 0x02, 0x3A};
+  static const uint8_t kArithmetic[] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE};
+  static const uint8_t kRange[] = {0x0, 0x2, 0x3};
+  int num_system = xochip ? 9 : schip ? 8 : 2;
+  int num_misc = xochip ? 15 : schip ? 12 : 9;
+  std::minstd_rand rng(seed);
+  std::vector<uint8_t> rom(std::max<size_t>(size + size % 2, 2));
+  for (size_t i = 0; i < rom.size(); i += 2) {
+    uint16_t opcode = rng() & 0xFFFF;
+    uint16_t target = (0x200 + rng() % rom.size()) & 0xFFE;
+    switch (opcode >> 12) {
+      case 0x0:
+        opcode = kSystem[rng() % num_system];
+        break;
+      case 0x2:
+        // Mostly jumps instead, or nearly every run overflows the stack.
+        if (rng() % 4 != 0) opcode = 0x1000 | (opcode & 0x0FFF);
+        opcode = (opcode & 0xF000) | target;
+        break;
+      case 0x1:
+      case 0xA:
+      case 0xB:
+        opcode = (opcode & 0xF000) | target;
+        break;
+      case 0x5:
+        // 5XY0, and 5XY2 or 5XY3 on XO-CHIP.
+        opcode = (opcode & 0xFFF0) | (xochip ? kRange[rng() % sizeof(kRange)] : 0);
+        break;
+      case 0x8:
+        opcode = (opcode & 0xFFF0) | kArithmetic[rng() % sizeof(kArithmetic)];
+        break;
+      case 0x9:
+        opcode &= 0xFFF0;
+        break;
+      case 0xE:
+        opcode = (opcode & 0xFF00) | (rng() % 2 ? 0x9E : 0xA1);
+        break;
+      case 0xF:
+        opcode = (opcode & 0xFF00) | kMisc[rng() % num_misc];
+        break;
+    }
+    rom[i] = opcode >> 8;
+    rom[i + 1] = opcode & 0xFF;
+  }
+  // Loop back to the start rather than run off the end.
+  rom[rom.size() - 2] = 0x12;
+  rom[rom.size() - 1] = 0x00;
+  rom.resize(std::max<size_t>(size, 2));
+  return rom;
+}
@@ -0,0 +1,55 @@
+#ifndef C8_VERIFIER_H_
+#define C8_VERIFIER_H_
+
+#include "common.h"
+#include "cpu_chip8.h"
+
+// Differential lockstep verification of execution engines.
+//
+// Runs a reference and a candidate engine (CpuChip8::Engine) side by side on
+// the same ROM, RND seed and keypad input, and compares a hash of their
+// registers, PC, I, timers, stack, fault register and frame after every
+// block of instructions. At the first divergence it stops with a state diff
+// of the two machines and the opcodes executed just before it. Memory is
+// compared once more at the end of the run.
+//
+// Keypad input is pseudo-random from the seed, so a run is reproducible
+// from its options alone.
+
+struct VerifyOptions {
+  CpuChip8::Machine machine = CpuChip8::Machine::kChip8;
+  CpuChip8::QuirkSet quirks = CpuChip8::QuirkSet::kAuto;
+  CpuChip8::Engine reference = CpuChip8::Engine::kReference;
+  CpuChip8::Engine candidate = CpuChip8::Engine::kTable;
+  // Frames to run, kCyclesPerFrame instructions each.
+  int frames = 600;
+  // Instructions between comparisons, 1 to compare after every one.
+  int block = 1;
+  // Executed opcodes kept for the divergence report.
+  int history = 32;
+  // Seeds RND and the keypad input.
+  uint32_t seed = 1;
+};
+
+struct VerifyResult {
+  bool diverged = false;
+  // Instructions each engine executed.
+  uint64_t cycles = 0;
+  // Both engines faulted identically, which ends the run early.
+  CpuChip8::Fault fault = CpuChip8::Fault::kNone;
+  // Chained hash of every compared state, for comparing whole runs.
+  uint64_t trace_hash = 0;
+  // When diverged, the state diff and opcode history.
+  std::string report;
+};
+
+// Throws if the ROM doesn't fit the machine.
+VerifyResult VerifyLockstep(const uint8_t* rom, size_t size, const VerifyOptions& options);
+
+// size bytes of random instructions for machine from seed. Every word is a
+// valid opcode, jumps and calls land inside the ROM and the ROM ends with a
+// jump back to its start, so runs get much further than with random bytes.
+// Stores through I can still turn code into anything.
+std::vector<uint8_t> FuzzRom(uint32_t seed, size_t size, CpuChip8::Machine machine);
+
+#endif
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "cpu_chip8.h"
+#include "verifier.h"
+
+// Runs the reference and candidate engines in lockstep over ROMs and fuzzed
+// ROMs, one run per core at a time. See verifier.h.
+// Usage: chip8_verify [--machine chip8|schip|xochip] [--quirks q]
+//   [--reference table|reference] [--candidate table|reference] [--frames n]
+//   [--block n] [--history n] [--fuzz count] [--fuzz-seed n] [--fuzz-size n]
+//   [-j threads] [rom...]
+
+namespace {
+struct Job {
+  // The ROM file, or empty for a fuzzed ROM.
+  std::string rom_filename;
+  uint32_t fuzz_seed = 0;
+  VerifyResult result;
+  std::string error;
+};
+}
+
+int main(int argc, char* args[]) {
+  VerifyOptions options;
+  int num_fuzz = 0;
+  uint32_t fuzz_seed = 1;
+  size_t fuzz_size = 512;
+  unsigned num_threads = std::thread::hardware_concurrency();
+  std::vector<Job> jobs;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = args[i];
+    bool ok = true;
+    if (arg == "--machine" && i + 1 < argc) {
+      ok = CpuChip8::ParseMachine(args[++i], &options.machine) &&
+        options.machine != CpuChip8::Machine::kAuto;
+    } else if (arg == "--quirks" && i + 1 < argc) {
+      ok = CpuChip8::ParseQuirkSet(args[++i], &options.quirks);
+    } else if (arg == "--reference" && i + 1 < argc) {
+      ok = CpuChip8::ParseEngine(args[++i], &options.reference);
+    } else if (arg == "--candidate" && i + 1 < argc) {
+      ok = CpuChip8::ParseEngine(args[++i], &options.candidate);
+    } else if (arg == "--frames" && i + 1 < argc) {
+      options.frames = std::stoi(args[++i]);
+    } else if (arg == "--block" && i + 1 < argc) {
+      options.block = std::stoi(args[++i]);
+    } else if (arg == "--history" && i + 1 < argc) {
+      options.history = std::stoi(args[++i]);
+    } else if (arg == "--fuzz" && i + 1 < argc) {
+      num_fuzz = std::stoi(args[++i]);
+    } else if (arg == "--fuzz-seed" && i + 1 < argc) {
+      fuzz_seed = std::stoul(args[++i]);
+    } else if (arg == "--fuzz-size" && i + 1 < argc) {
+      fuzz_size = std::stoul(args[++i]);
+    } else if (arg == "-j" && i + 1 < argc) {
+      num_threads = std::stoi(args[++i]);
+    } else {
+      jobs.push_back(Job());
+      jobs.back().rom_filename = arg;
+    }
+    if (!ok) {
+      std::cerr << "Bad value for " << arg << ": " << args[i] << "\n";
+      return 2;
+    }
+  }
+  for (int f = 0; f < num_fuzz; f++) {
+    jobs.push_back(Job());
+    jobs.back().fuzz_seed = fuzz_seed + f;
+  }
+  if (jobs.empty()) {
+    std::cerr << "Usage: " << args[0] << " [--machine m] [--quirks q] [--reference e] "
+      "[--candidate e] [--frames n] [--block n] [--fuzz count] [-j threads] [rom...]\n";
+    return 2;
+  }
+
+  std::atomic<size_t> next_job(0);
+  std::atomic<bool> diverged(false);
+  std::mutex out_mu;
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < std::max(1u, num_threads); t++) {
+    workers.emplace_back([&]() {
+      // Stop handing out runs after the first divergence.
+      for (size_t i = next_job++; i < jobs.size() && !diverged.load(); i = next_job++) {
+        Job& job = jobs[i];
+        VerifyOptions job_options = options;
+        std::vector<uint8_t> rom;
+        if (job.rom_filename.empty()) {
+          rom = FuzzRom(job.fuzz_seed, fuzz_size, job_options.machine);
+          job_options.seed = job.fuzz_seed;
+        } else {
+          std::ifstream input(job.rom_filename, std::ios::in | std::ios::binary);
+          rom.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        }
+        try {
+          job.result = VerifyLockstep(rom.data(), rom.size(), job_options);
+        } catch (const std::exception& e) {
+          job.error = e.what();
+        }
+        if (job.result.diverged) {
+          diverged = true;
+          const std::lock_guard<std::mutex> lock(out_mu);
+          std::cout << (job.rom_filename.empty() ? "fuzz seed " + std::to_string(job.fuzz_seed)
+            : job.rom_filename) << ": " << job.result.report;
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  int num_run = 0;
+  int num_errors = 0;
+  int num_faulted = 0;
+  uint64_t num_cycles = 0;
+  for (const auto& job : jobs) {
+    if (!job.error.empty()) {
+      std::cerr << job.rom_filename << ": ERROR: " << job.error << "\n";
+      num_errors++;
+      continue;
+    }
+    if (job.result.cycles == 0) continue;
+    num_run++;
+    num_faulted += job.result.fault != CpuChip8::Fault::kNone;
+    num_cycles += job.result.cycles;
+  }
+  std::cout << num_run << " runs, " << num_cycles << " instructions compared, "
+    << num_faulted << " ended in a fault, " << (diverged.load() ? "DIVERGED" : "no divergence")
+    << ".\n";
+  if (diverged.load()) return 1;
+  return num_errors > 0 ? 2 : 0;
+}
@@ -0,0 +1,60 @@
+#include "wav_writer.h"
+
+#include <fstream>
+
+#include "common.h"
+#include "sound.h"
+
+namespace {
+void WriteLE(std::ofstream& out, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+void WriteHeader(std::ofstream& out, int sample_rate, uint32_t num_samples) {
+  uint32_t data_bytes = num_samples * sizeof(int16_t);
+  out.write("RIFF", 4);
+  WriteLE(out, 36 + data_bytes, 4);
+  out.write("WAVEfmt ", 8);
+  WriteLE(out, 16, 4);                // fmt chunk size
+  WriteLE(out, 1, 2);                 // PCM
+  WriteLE(out, 1, 2);                 // mono
+  WriteLE(out, sample_rate, 4);
+  WriteLE(out, sample_rate * 2, 4);   // byte rate
+  WriteLE(out, 2, 2);                 // block align
+  WriteLE(out, 16, 2);                // bits per sample
+  out.write("data", 4);
+  WriteLE(out, data_bytes, 4);
+}
+}
+
+WavWriter::WavWriter(const std::string& filename, int cycle_speed_hz, int tone_hz) :
+    output_(filename, std::ios::out | std::ios::binary | std::ios::trunc),
+    wave_(kSampleRate, tone_hz, cycle_speed_hz) {
+  if (!output_) {
+    throw std::runtime_error("Couldn't open " + filename);
+  }
+  // Placeholder, rewritten with the real sizes on destruction.
+  WriteHeader(output_, kSampleRate, 0);
+}
+
+WavWriter::~WavWriter() {
+  output_.seekp(0);
+  WriteHeader(output_, kSampleRate, num_samples_);
+}
+
+void WavWriter::Drain(SoundRing* edges, uint64_t up_to_cycle) {
+  int16_t samples[1024];
+  while (wave_.Cycle() < up_to_cycle) {
+    int count = 0;
+    // Render one sample at a time near the end so we stop on the cycle.
+    while (count < 1024 && wave_.Cycle() < up_to_cycle) {
+      wave_.Render(edges, &samples[count++], 1, /*realtime=*/false);
+    }
+    for (int i = 0; i < count; i++) {
+      WriteLE(output_, static_cast<uint16_t>(samples[i]), 2);
+    }
+    num_samples_ += count;
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef C8_WAV_WRITER_H_
+#define C8_WAV_WRITER_H_
+
+#include <fstream>
+
+#include "common.h"
+#include "sound.h"
+
+// Writes the CPU's sound edges to a 16-bit mono WAV file, sample-accurate to
+// the emulated cycle clock. For headless runs.
+
+class WavWriter {
+  public:
+    WavWriter(const std::string& filename, int cycle_speed_hz, int tone_hz = 440);
+    // Finalizes the header.
+    ~WavWriter();
+
+    // Consumes pending edges and renders audio up to the given cycle.
+    // Call from the thread that owns the ring's consumer side.
+    void Drain(SoundRing* edges, uint64_t up_to_cycle);
+
+  private:
+    static constexpr int kSampleRate = 44100;
+
+    std::ofstream output_;
+    SquareWave wave_;
+    uint32_t num_samples_ = 0;
+};
+
+#endif